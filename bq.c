@@ -0,0 +1,248 @@
+#include "bq.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#define MAX_KEY 4611686018427387904.0	// 2^62
+
+/*
+* every bucket (and the overflow list) is a doubly linked list
+*   threaded through next/prev, so an entry is unlinked in O(1)
+*   when its priority decreases.  List nb is the overflow list.
+*/
+struct bq_struct {
+	long long* key;		// priority of each id
+	int* where;			// list holding each id; -1 if absent
+	int* next;
+	int* prev;
+	int* head;			// first id of each list; -1 if empty
+	int nb;				// number of buckets (max_step+1)
+	long long last;		// last minimum returned
+	long long ovmin;	// lower bound on the overflow list's priorities
+	int nbucketed;		// entries in buckets (not overflow)
+	int size;
+	int capacity;
+};
+
+static int to_key(BQ* bq, double priority, long long* key);
+static void link_id(BQ* bq, int id);
+static void unlink_id(BQ* bq, int id);
+static void refill(BQ* bq);
+
+BQ* bq_create(int capacity, int max_step) {
+	if(max_step < 0) {
+		printf("Max step must be non-negative.\n");
+		return NULL;
+	}
+
+	BQ* bq = malloc(sizeof(BQ));
+	bq->nb = max_step+1;
+	bq->key = malloc(sizeof(long long)*capacity);
+	bq->where = malloc(sizeof(int)*capacity);
+	bq->next = malloc(sizeof(int)*capacity);
+	bq->prev = malloc(sizeof(int)*capacity);
+	bq->head = malloc(sizeof(int)*(bq->nb+1));
+	bq->last = 0;
+	bq->ovmin = LLONG_MAX;
+	bq->nbucketed = 0;
+	bq->size = 0;
+	bq->capacity = capacity;
+
+	int i;
+	for(i = 0; i < capacity; i++)
+		bq->where[i] = -1;
+	for(i = 0; i <= bq->nb; i++)
+		bq->head[i] = -1;
+
+	return bq;
+}
+
+void bq_free(BQ* bq) {
+	if(bq == NULL)
+		return;
+	free(bq->key);
+	free(bq->where);
+	free(bq->next);
+	free(bq->prev);
+	free(bq->head);
+	free(bq);
+}
+
+void bq_reset(BQ* bq) {
+	int l, id;
+
+	for(l = 0; l <= bq->nb; l++) {
+		for(id = bq->head[l]; id != -1; id = bq->next[id])
+			bq->where[id] = -1;
+		bq->head[l] = -1;
+	}
+	bq->last = 0;
+	bq->ovmin = LLONG_MAX;
+	bq->nbucketed = 0;
+	bq->size = 0;
+}
+
+int bq_insert(BQ* bq, int id, double priority) {
+	long long key;
+
+	if(id < 0 || id >= bq->capacity) {
+		printf("ID out of range.\n");
+		return 0;
+	}
+
+	if(bq->where[id] != -1) {
+		printf("ID in use.\n");
+		return 0;
+	}
+
+	if(!to_key(bq, priority, &key))
+		return 0;
+
+	bq->key[id] = key;
+	link_id(bq, id);
+	bq->size++;
+
+	return 1;
+}
+
+int bq_decrease_key(BQ* bq, int id, double new_priority) {
+	long long key;
+
+	if(id < 0 || id >= bq->capacity) {
+		printf("ID out of range.\n");
+		return 0;
+	}
+
+	if(bq->where[id] == -1) {
+		printf("ID not in use.\n");
+		return 0;
+	}
+
+	if(!to_key(bq, new_priority, &key))
+		return 0;
+
+	if(key > bq->key[id]) {
+		printf("Priority moves away from top.\n");
+		return 0;
+	}
+
+	unlink_id(bq, id);
+	bq->key[id] = key;
+	link_id(bq, id);
+
+	return 1;
+}
+
+int bq_delete_min(BQ* bq, int *id, double *priority) {
+	int b;
+
+	if(bq->size == 0) {
+		printf("Empty priority queue.\n");
+		return 0;
+	}
+
+	// only overflow entries left:  jump ahead to the smallest
+	while(bq->nbucketed == 0) {
+		if(bq->ovmin > bq->last)
+			bq->last = bq->ovmin;
+		refill(bq);
+	}
+
+	// advance to the first nonempty bucket, pulling in overflow
+	//   entries as the range reaches them
+	for(;;) {
+		if(bq->ovmin <= bq->last + bq->nb-1)
+			refill(bq);
+		b = (int)(bq->last % bq->nb);
+		if(bq->head[b] != -1)
+			break;
+		bq->last++;
+	}
+
+	*id = bq->head[b];
+	*priority = (double)bq->key[*id];
+	unlink_id(bq, *id);
+	bq->where[*id] = -1;
+	bq->size--;
+
+	return 1;
+}
+
+int bq_size(BQ* bq) {
+	return bq->size;
+}
+
+int bq_contains(BQ* bq, int id) {
+	return bq->where[id] != -1;
+}
+
+/**** UTILITY FUNCTIONS *******/
+
+// maps a priority to its key; 0 (with a message) if invalid
+static int to_key(BQ* bq, double priority, long long* key) {
+	if(!(priority >= 0.0) || priority >= MAX_KEY
+			|| priority != (double)(long long)priority) {
+		printf("Priority must be a non-negative whole number.\n");
+		return 0;
+	}
+
+	*key = (long long)priority;
+	if(*key < bq->last) {
+		printf("Priority below last minimum.\n");
+		return 0;
+	}
+	return 1;
+}
+
+// puts id at the front of its bucket, or of the overflow list
+static void link_id(BQ* bq, int id) {
+	long long key = bq->key[id];
+	int l;
+
+	if(key - bq->last < bq->nb) {
+		l = (int)(key % bq->nb);
+		bq->nbucketed++;
+	}
+	else {
+		l = bq->nb;
+		if(key < bq->ovmin)
+			bq->ovmin = key;
+	}
+	bq->where[id] = l;
+	bq->prev[id] = -1;
+	bq->next[id] = bq->head[l];
+	if(bq->head[l] != -1)
+		bq->prev[bq->head[l]] = id;
+	bq->head[l] = id;
+}
+
+static void unlink_id(BQ* bq, int id) {
+	int l = bq->where[id];
+
+	if(bq->prev[id] != -1)
+		bq->next[bq->prev[id]] = bq->next[id];
+	else
+		bq->head[l] = bq->next[id];
+	if(bq->next[id] != -1)
+		bq->prev[bq->next[id]] = bq->prev[id];
+	if(l != bq->nb)
+		bq->nbucketed--;
+}
+
+// moves overflow entries now within range into the buckets and
+//   recomputes ovmin exactly
+static void refill(BQ* bq) {
+	int id = bq->head[bq->nb], nxt;
+
+	bq->ovmin = LLONG_MAX;
+	for(; id != -1; id = nxt) {
+		nxt = bq->next[id];
+		if(bq->key[id] - bq->last < bq->nb) {
+			unlink_id(bq, id);
+			link_id(bq, id);
+		}
+		else if(bq->key[id] < bq->ovmin)
+			bq->ovmin = bq->key[id];
+	}
+}
+/**** END UTILITY FUNCTIONS *******/
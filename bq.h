@@ -0,0 +1,90 @@
+/**
+* General description:  bucket queue (Dial's algorithm) storing
+*   pairs <id, priority> with the same id model as pq:  IDs are
+*   integers in [0..N-1], N the capacity set on creation, and
+*   there is at most one entry per id.  The top is always the
+*   minimum priority.
+*
+*   Priorities must be non-negative whole numbers.  Like rheap,
+*   the queue is monotone:  no priority may be below the last
+*   minimum returned by bq_delete_min.
+*
+*   The queue keeps max_step+1 buckets used circularly; bucket
+*   p % (max_step+1) holds the entries with priority p for p in
+*   [last, last+max_step], where last is the last minimum.  Insert
+*   and decrease_key are O(1) and delete_min scans at most
+*   max_step+1 buckets.  In Dijkstra's algorithm with integer edge
+*   lengths <= max_step every tentative distance is in that range.
+*
+*   Entries with priority beyond last+max_step (e.g. the
+*   "infinite" placeholders Dijkstra starts with) are parked
+*   unsorted on an overflow list, and moved into the buckets when
+*   the range reaches their smallest priority; each such move
+*   scans the whole overflow list.
+**/
+
+// "Opaque type" -- definition of bq_struct hidden in bq.c
+typedef struct bq_struct BQ;
+
+/**
+* Function: bq_create
+* Parameters: capacity - number of ids
+*             max_step - largest amount by which a priority may
+*                        exceed the last minimum and still be
+*                        bucketed (max edge length for Dijkstra)
+* Returns:  Pointer to empty bucket queue, or NULL if max_step
+*           is negative.
+*/
+extern BQ * bq_create(int capacity, int max_step);
+
+/**
+* Function: bq_free
+* Desc: deallocates all memory associated with bq.
+*/
+extern void bq_free(BQ * bq);
+
+/**
+* Function: bq_reset
+* Desc: removes all entries and forgets the last minimum, leaving
+*       bq as if just created, without allocating.
+* Runtime:  O(size + max_step)
+*/
+extern void bq_reset(BQ * bq);
+
+/**
+* Function: bq_insert
+* Returns: 1 on success; 0 on failure.
+*          fails if id is out of range, already present, or
+*            priority is not a whole number >= the last minimum.
+* Runtime:  O(1)
+*/
+extern int bq_insert(BQ * bq, int id, double priority);
+
+/**
+* Function: bq_decrease_key
+* Returns: 1 on success; 0 on failure.
+*          fails if id is not present, or new_priority is larger
+*            than the current one, not a whole number, or below
+*            the last minimum.
+* Runtime:  O(1)
+*/
+extern int bq_decrease_key(BQ * bq, int id, double new_priority);
+
+/**
+* Function: bq_delete_min
+* Parameters: int pointer id and double pointer priority ("out")
+* Returns: 1 on success; 0 on failure (empty queue)
+* Desc: removes an entry with minimum priority and stores its
+*       id and priority in *id and *priority.
+* Runtime:  O(max_step) worst case; amortized O(1) when the
+*           minimum advances steadily, as in Dijkstra
+*/
+extern int bq_delete_min(BQ * bq, int *id, double *priority);
+
+/**
+* Function: bq_size, bq_contains
+* same semantics as pq_size and pq_contains.
+* Runtime:  O(1)
+*/
+extern int bq_size(BQ * bq);
+extern int bq_contains(BQ * bq, int id);
@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "hmap.h"
+#include "chmap.h"
+
+#define SHARD_INIT_SIZE 16
+#define CACHE_LINE 64
+
+/* all fields a reader can see while a writer changes them are
+*    accessed with these.
+*/
+#define LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+
+/******** STRUCTS AND TYPEDEFS *********/
+
+typedef struct node_struct_chmap {
+    struct node_struct_chmap *next;
+    char *key;
+    void *val;
+    unsigned hval;
+    unsigned klen;
+} NODE_CHMAP;
+
+typedef struct ctbl_struct {
+    NODE_CHMAP **buckets;
+    int tsize;                  // power of 2
+    struct ctbl_struct *retired_next;
+} CTBL;
+
+typedef struct {
+    pthread_mutex_t lock;       // serializes writers
+    unsigned seq;               // odd while a structural change runs
+    CTBL *tbl;
+    int n;
+    NODE_CHMAP *retired_nodes;  // removed, awaiting chmap_reclaim
+    CTBL *retired_tbls;         // outgrown, awaiting chmap_reclaim
+} SHARD;
+
+// pad shards to a cache line so writers in one shard don't
+//   invalidate readers' copies of their neighbours.
+typedef union {
+    SHARD s;
+    char pad[(sizeof(SHARD) + CACHE_LINE-1) / CACHE_LINE * CACHE_LINE];
+} SHARD_SLOT;
+
+struct chmap {
+    SHARD_SLOT *shards;
+    int nshards;                // power of 2
+    int shard_bits;
+    HFUNC hfunc;
+};
+
+/******** END STRUCTS AND TYPEDEFS *********/
+
+/***** FORWARD DECLARATIONS *****/
+static unsigned mix(unsigned h);
+static SHARD *shard_for(CHMAP_PTR map, unsigned h);
+static CTBL *create_ctbl(int tsize);
+static NODE_CHMAP *find_node(SHARD *sh, char *key, unsigned len, unsigned h,
+				void **val);
+static void write_begin(SHARD *sh);
+static void write_end(SHARD *sh);
+static void grow(SHARD *sh);
+static void free_nodes(NODE_CHMAP *p, int free_vals);
+/***** END FORWARD DECLARATIONS *****/
+
+
+/***** BEGIN chmap FUNCTIONS ******/
+
+CHMAP_PTR chmap_create(int nshards, int hfunc_id) {
+CHMAP_PTR map = malloc(sizeof(struct chmap));
+int i;
+
+  if(nshards <= 0)
+	nshards = CHMAP_DEFAULT_SHARDS;
+  map->nshards = 1;
+  map->shard_bits = 0;
+  while(map->nshards < nshards) {
+	map->nshards *= 2;
+	map->shard_bits++;
+  }
+  map->hfunc = hmap_builtin_hfunc(hfunc_id);
+  if(map->hfunc == NULL)
+	map->hfunc = hmap_builtin_hfunc(DEFAULT_HFUNC_ID);
+
+  map->shards = malloc(map->nshards * sizeof(SHARD_SLOT));
+  for(i=0; i<map->nshards; i++) {
+	SHARD *sh = &map->shards[i].s;
+
+	pthread_mutex_init(&sh->lock, NULL);
+	sh->seq = 0;
+	sh->tbl = create_ctbl(SHARD_INIT_SIZE);
+	sh->n = 0;
+	sh->retired_nodes = NULL;
+	sh->retired_tbls = NULL;
+  }
+  return map;
+}
+
+int chmap_size(CHMAP_PTR map) {
+int i, n = 0;
+
+  for(i=0; i<map->nshards; i++)
+	n += __atomic_load_n(&map->shards[i].s.n, __ATOMIC_RELAXED);
+  return n;
+}
+
+int chmap_contains(CHMAP_PTR map, char *key) {
+unsigned h = map->hfunc(key);
+void *val;
+
+  return find_node(shard_for(map, h), key, strlen(key), h, &val) != NULL;
+}
+
+void *chmap_get(CHMAP_PTR map, char *key) {
+unsigned h = map->hfunc(key);
+void *val;
+
+  if(find_node(shard_for(map, h), key, strlen(key), h, &val) == NULL)
+	return NULL;
+  return val;
+}
+
+void *chmap_set(CHMAP_PTR map, char *key, void *val) {
+unsigned h = map->hfunc(key);
+unsigned len = strlen(key);
+SHARD *sh = shard_for(map, h);
+NODE_CHMAP *p, **bucket;
+void *old;
+
+  pthread_mutex_lock(&sh->lock);
+  p = find_node(sh, key, len, h, &old);
+  if(p != NULL) {  // in place; readers see old or new value
+	__atomic_store_n(&p->val, val, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&sh->lock);
+	return old;
+  }
+  p = malloc(sizeof(NODE_CHMAP));
+  p->key = malloc(len + 1);
+  memcpy(p->key, key, len + 1);
+  p->klen = len;
+  p->hval = h;
+  p->val = val;
+
+  write_begin(sh);
+  if(sh->n + 1 > sh->tbl->tsize)
+	grow(sh);
+  bucket = &sh->tbl->buckets[mix(h) & (sh->tbl->tsize-1)];
+  p->next = *bucket;
+  STORE(bucket, p);
+  __atomic_store_n(&sh->n, sh->n + 1, __ATOMIC_RELAXED);
+  write_end(sh);
+
+  pthread_mutex_unlock(&sh->lock);
+  return NULL;
+}
+
+void *chmap_remove(CHMAP_PTR map, char *key) {
+unsigned h = map->hfunc(key);
+unsigned len = strlen(key);
+SHARD *sh = shard_for(map, h);
+NODE_CHMAP *p, **pp;
+void *val = NULL;
+
+  pthread_mutex_lock(&sh->lock);
+  pp = &sh->tbl->buckets[mix(h) & (sh->tbl->tsize-1)];
+  for(p = *pp; p != NULL; pp = &p->next, p = *pp)
+	if(p->hval == h && p->klen == len && memcmp(key, p->key, len)==0)
+	   break;
+  if(p != NULL) {
+	val = p->val;
+	write_begin(sh);
+	STORE(pp, p->next);  // p->next stays intact for readers on p
+	__atomic_store_n(&sh->n, sh->n - 1, __ATOMIC_RELAXED);
+	write_end(sh);
+	// a reader that started before the unlink may still be on p;
+	//   it will fail validation, but must still see a finite chain.
+	STORE(&p->val, NULL);  // client owns the value from now on
+	STORE(&p->next, sh->retired_nodes);
+	sh->retired_nodes = p;
+  }
+  pthread_mutex_unlock(&sh->lock);
+  return val;
+}
+
+void chmap_reclaim(CHMAP_PTR map) {
+int i;
+CTBL *t, *nxt;
+
+  for(i=0; i<map->nshards; i++) {
+	SHARD *sh = &map->shards[i].s;
+
+	free_nodes(sh->retired_nodes, 0);
+	sh->retired_nodes = NULL;
+	for(t=sh->retired_tbls; t != NULL; t=nxt) {
+	   nxt = t->retired_next;
+	   free(t->buckets);
+	   free(t);
+	}
+	sh->retired_tbls = NULL;
+  }
+}
+
+void chmap_free(CHMAP_PTR map, int free_vals) {
+int i, j;
+
+  chmap_reclaim(map);
+  for(i=0; i<map->nshards; i++) {
+	SHARD *sh = &map->shards[i].s;
+
+	for(j=0; j<sh->tbl->tsize; j++)
+	   free_nodes(sh->tbl->buckets[j], free_vals);
+	free(sh->tbl->buckets);
+	free(sh->tbl);
+	pthread_mutex_destroy(&sh->lock);
+  }
+  free(map->shards);
+  free(map);
+}
+
+/***** END chmap FUNCTIONS ******/
+
+
+/**** UTILITY FUNCTIONS *******/
+
+// the built-in hashes have weak bits; shard index comes from
+//   the top bits and bucket index from the low bits of this.
+static unsigned mix(unsigned h) {
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+static SHARD *shard_for(CHMAP_PTR map, unsigned h) {
+  if(map->shard_bits == 0)
+	return &map->shards[0].s;
+  return &map->shards[mix(h) >> (32 - map->shard_bits)].s;
+}
+
+static CTBL *create_ctbl(int tsize) {
+CTBL *t = malloc(sizeof(CTBL));
+
+  t->tsize = tsize;
+  t->buckets = calloc(tsize, sizeof(NODE_CHMAP *));
+  t->retired_next = NULL;
+  return t;
+}
+
+/*
+* seqlock read side:  walk the chain without locking, then
+*   check that no structural change started or finished in
+*   the meantime; retry if one did.  Nodes and tables are never
+*   freed while readers may run, so a stale pointer is always
+*   safe to follow.
+*/
+static NODE_CHMAP *find_node(SHARD *sh, char *key, unsigned len, unsigned h,
+				void **val) {
+unsigned s0;
+CTBL *t;
+NODE_CHMAP *p;
+
+  for(;;) {
+    s0 = LOAD(&sh->seq);
+    if(s0 & 1)
+	continue;  // writer mid-change
+    t = LOAD(&sh->tbl);
+    p = LOAD(&t->buckets[mix(h) & (t->tsize-1)]);
+    while(p != NULL) {
+	if(p->hval == h && p->klen == len && memcmp(key, p->key, len)==0) {
+	   *val = LOAD(&p->val);
+	   break;
+	}
+	p = LOAD(&p->next);
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&sh->seq, __ATOMIC_RELAXED) == s0)
+	return p;
+  }
+}
+
+static void write_begin(SHARD *sh) {
+  __atomic_store_n(&sh->seq, sh->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void write_end(SHARD *sh) {
+  STORE(&sh->seq, sh->seq + 1);
+}
+
+// doubles the shard's table; caller holds the lock and has
+//   called write_begin.
+static void grow(SHARD *sh) {
+CTBL *old = sh->tbl, *t = create_ctbl(2*old->tsize);
+NODE_CHMAP *p, *nxt;
+int i, idx;
+
+  for(i=0; i<old->tsize; i++)
+	for(p=old->buckets[i]; p != NULL; p=nxt) {
+	   nxt = p->next;
+	   idx = mix(p->hval) & (t->tsize-1);
+	   STORE(&p->next, t->buckets[idx]);
+	   t->buckets[idx] = p;
+	}
+  STORE(&sh->tbl, t);
+  old->retired_next = sh->retired_tbls;
+  sh->retired_tbls = old;
+}
+
+static void free_nodes(NODE_CHMAP *p, int free_vals) {
+NODE_CHMAP *nxt;
+
+  for(; p != NULL; p=nxt) {
+	nxt = p->next;
+	free(p->key);
+	if(free_vals && p->val != NULL)
+	   free(p->val);
+	free(p);
+  }
+}
+/**** END UTILITY FUNCTIONS *******/
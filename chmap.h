@@ -0,0 +1,72 @@
+
+/**
+* General description:  thread-safe string-keyed map with the
+*   same key/value model as hmap (char * keys are copied,
+*   void * values belong to the client).
+*
+*   The key space is split into independently locked shards
+*   selected by the key's hash.  Writers (set/remove) take the
+*   shard's mutex; readers (get/contains) take no lock at all
+*   and validate what they read against the shard's sequence
+*   counter, retrying only if a structural change (insert,
+*   remove or table growth) ran concurrently in the same
+*   shard.  Updating the value of an existing key does not
+*   disturb readers.
+*
+*   Removed entries and outgrown tables are not freed while
+*   the map is live since a reader may still be looking at
+*   them; they are released by chmap_reclaim (when no other
+*   thread is using the map) or by chmap_free.
+*
+*   For single-threaded use, hmap remains the fast path.
+**/
+
+typedef struct chmap *CHMAP_PTR;
+
+#define CHMAP_DEFAULT_SHARDS 64
+
+/**
+* Creates an empty map.
+*
+* \param nshards number of shards; rounded up to a power of
+*   two.  If zero, CHMAP_DEFAULT_SHARDS is used.
+* \param hfunc_id one of the hmap built-in hash function ids
+*   (see hmap.h); an invalid id selects DEFAULT_HFUNC_ID.
+*/
+extern CHMAP_PTR chmap_create(int nshards, int hfunc_id);
+
+/**
+* \returns number of distinct keys in the map (a snapshot if
+*   writers are active).
+*/
+extern int chmap_size(CHMAP_PTR map);
+
+/**
+* same semantics as hmap_contains and hmap_get.  Lock-free;
+*   safe to call concurrently with any other chmap operation
+*   except chmap_reclaim and chmap_free.
+*/
+extern int chmap_contains(CHMAP_PTR map, char *key);
+extern void *chmap_get(CHMAP_PTR map, char *key);
+
+/**
+* same semantics as hmap_set and hmap_remove.  Serialized
+*   per shard.
+*/
+extern void *chmap_set(CHMAP_PTR map, char *key, void *val);
+extern void *chmap_remove(CHMAP_PTR map, char *key);
+
+/**
+* frees entries removed since the last reclaim and tables
+*   left behind by growth.
+*
+* Must only be called while no other thread is using the map.
+*/
+extern void chmap_reclaim(CHMAP_PTR map);
+
+/**
+* Deallocates the map.  free_vals_flag as in hmap_free.
+*   No other thread may be using the map.
+*/
+extern void chmap_free(CHMAP_PTR map, int free_vals_flag);
+
@@ -2,17 +2,98 @@
 #include <stdlib.h>
 #include <string.h>
 #include "hmap.h"
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define HAVE_CRC32_INSN 1
+#endif
 
 #define BASE1 27
 
+/* flat engine control bytes:  a full slot holds the low 7 
+*    bits of its (mixed) hash; empty and deleted slots have 
+*    the high bit set so one compare finds either.
+*/
+#define GROUP_SIZE 16
+#define CTRL_EMPTY ((signed char)0x80)
+#define CTRL_DELETED ((signed char)0xFE)
+
+/* arena mode:  slab size and key size classes.  Key buffers
+*    are rounded up to KEY_ALIGN bytes; buffers of up to
+*    KEY_CLASSES*KEY_ALIGN bytes are recycled through per-class
+*    free lists, longer ones are only reclaimed by hmap_free.
+*/
+#define SLAB_SIZE (64*1024)
+#define KEY_ALIGN 8
+#define KEY_CLASSES 8
+
+/* frozen index:  average keys per pilot bucket, the load of
+*    the slot table the pilots search (below 1 so the last 
+*    buckets still find free slots quickly), the pilot value at
+*    which a seed is abandoned, and the seeds tried before 
+*    hmap_freeze gives up.
+*
+*    As in PTHash, buckets are skewed:  the 60% of keys whose
+*    hash is below FROZEN_DENSE_KEYS go to the first 30% of 
+*    buckets.  Those large buckets are placed while the table is
+*    mostly empty, leaving small ones for the crowded end.
+*/
+#define FROZEN_BUCKET_LOAD 4
+#define FROZEN_ALPHA 0.99
+#define FROZEN_DENSE_KEYS 2576980377ull   // 0.6 * 2^32
+#define FROZEN_DENSE_BUCKETS 0.3
+#define FROZEN_MAX_PILOT (1u << 24)
+#define FROZEN_MAX_ATTEMPTS 16
+
+/* hmap_get_batch works on windows of this many keys:  all
+*    of a window's memory accesses are prefetched one stage
+*    ahead of when they are needed.
+*/
+#define BATCH_WINDOW 16
+
+#define PREFETCH(addr) __builtin_prefetch(addr)
+
+/* negative-lookup filter:  a blocked Bloom filter with one 
+*    64 byte block per probe; BLOOM_K bits are set per key in
+*    a block chosen by the key's hash.  Sized for BLOOM_BITS 
+*    bits per key at the table's maximum load (about 1-2% 
+*    false positives).  Removals cannot clear bits, so the
+*    filter is rebuilt after more than n/4 (+ BLOOM_MIN_STALE)
+*    removals.  An incremental resize starts an empty, larger 
+*    filter and fills it as buckets migrate, consulting the old
+*    one for unmigrated buckets.
+*/
+#define BLOOM_BITS 10
+#define BLOOM_K 6
+#define BLOOM_BLOCK_WORDS 8
+#define BLOOM_MIN_STALE 64
+
 
 /******** STRUCTS AND TYPEDEFS *********/
 
+/* keys shorter than INLINE_KEY_SIZE (nul included) live in
+*    the node/slot itself; longer ones are cloned separately.
+*    Which member is in use is implied by the key length.
+*/
+#define INLINE_KEY_SIZE 16
+
+typedef union {
+    char *ptr;
+    char bytes[INLINE_KEY_SIZE];
+} KEY_STORE;
+
+#define IS_INLINE(len) ((len) < INLINE_KEY_SIZE)
+#define KEY_OF(p) (IS_INLINE((p)->klen) ? (p)->k.bytes : (p)->k.ptr)
+
 typedef struct node_struct_hmap {
     struct node_struct_hmap *next;
-    char *key;
     void *val;
     unsigned hval;
+    unsigned klen;
+    KEY_STORE k;
 }NODE_HMAP;
 
 typedef struct {
@@ -20,14 +101,73 @@ typedef struct {
     int n;
 } TBL_ENTRY;
 
+typedef struct {
+    void *val;
+    unsigned hval;
+    unsigned klen;
+    KEY_STORE k;
+} SLOT_HMAP;
+
+/* frozen index:  slot i holds the key stored at 
+*    blob[key_off[i] .. key_off[i+1]) and value vals[i].
+*    A key's position is p = (h ^ mix(pilots[bucket(h)])) % m 
+*    where h is the seeded 64 bit hash of the key and m is 
+*    about n/FROZEN_ALPHA; its slot is p if p < n, else 
+*    remap[p-n] (one of the slots below n left free).
+*/
+struct hmap_frozen {
+    int n;
+    int m;             // positions the pilots search
+    int nbuckets;
+    int ndense;        // buckets taking the dense 60% of keys
+    uint64_t seed;
+    uint32_t *pilots;
+    uint32_t *remap;   // m-n entries
+    uint32_t *key_off;
+    char *blob;
+    void **vals;
+};
+
+typedef struct slab_struct {
+    struct slab_struct *next;
+    size_t used;
+    size_t cap;
+} SLAB;   // followed by cap bytes of storage
+
+typedef struct free_chunk {
+    struct free_chunk *next;
+} FREE_CHUNK;
+
 struct hmap {
-    TBL_ENTRY *tbl;
+    int engine;
+    TBL_ENTRY *tbl;    // HMAP_CHAINED only
+    signed char *ctrl; // HMAP_FLAT only:  tsize control bytes
+    SLOT_HMAP *slots;  // HMAP_FLAT only:  tsize slots
+    int ndeleted;      // HMAP_FLAT only:  tombstones
+    int use_arena;
+    uint64_t *bloom;     // NULL unless HMAP_BLOOM
+    void *bloom_base;    // allocation behind bloom
+    unsigned bloom_mask; // number of blocks - 1
+    int bloom_stale;     // removals since last rebuild
+    int incremental;
+    TBL_ENTRY *old_tbl;  // non-NULL while a migration is running
+    int old_tsize;
+    int migrate_pos;     // old buckets below this have been moved
+    int migrate_nbuckets; // old buckets moved per operation
+    uint64_t *old_bloom; // filter for the unmigrated old buckets
+    void *old_bloom_base;
+    unsigned old_bloom_mask;
+    SLAB *slabs;       // arena only:  newest slab first
+    NODE_HMAP *free_nodes;              // arena only
+    FREE_CHUNK *free_keys[KEY_CLASSES]; // arena only
     int tsize;
     int n; 
     double lfactor;
     int max_n;
     HFUNC hfunc;
     char *hfunc_desc;
+    int nresizes;
+    size_t nbytes;       // bytes currently allocated by the map
 };
 
 typedef struct {
@@ -59,6 +199,145 @@ unsigned h=0;
   }
   return h;
 }
+
+static unsigned fold64(uint64_t h) {
+  return (unsigned)(h ^ (h >> 32));
+}
+
+static uint64_t load64(const char *s) {
+uint64_t w;
+  memcpy(&w, s, sizeof(w));
+  return w;
+}
+
+// loads the last len (< 8) bytes of a key, zero padded
+static uint64_t load_tail(const char *s, size_t len) {
+uint64_t w = 0;
+  memcpy(&w, s, len);
+  return w;
+}
+
+static unsigned h_fnv1a(char *s) {
+uint64_t h = 0xcbf29ce484222325ull;
+
+  while(*s != '\0') {
+	h ^= (unsigned char)*s;
+	h *= 0x100000001b3ull;
+	s++;
+  }
+  return fold64(h);
+}
+
+// 64x64->128 multiply, returns xor of the halves
+static uint64_t mum(uint64_t a, uint64_t b) {
+__uint128_t r = (__uint128_t)a * b;
+  return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+static uint64_t wymix64(const char *s, size_t len, uint64_t seed) {
+const uint64_t p0 = 0xa0761d6478bd642full, p1 = 0xe7037ed1a0b428dbull;
+uint64_t h = p0 ^ len ^ seed;
+size_t i;
+
+  for(i=0; i+8 <= len; i+=8)
+	h = mum(h ^ load64(s+i), p1);
+  h = mum(h ^ load_tail(s+i, len-i), p1 ^ len);
+  return mum(h, p0);
+}
+
+static unsigned h_wymix(char *s) {
+  return fold64(wymix64(s, strlen(s), 0));
+}
+
+// CRC32C (Castagnoli, reflected polynomial 0x82f63b78) by byte;
+//   a constant so concurrent first callers never see it half built
+static const uint32_t crc32c_table[256] = {
+	0x00000000u, 0xf26b8303u, 0xe13b70f7u, 0x1350f3f4u, 0xc79a971fu, 0x35f1141cu,
+	0x26a1e7e8u, 0xd4ca64ebu, 0x8ad958cfu, 0x78b2dbccu, 0x6be22838u, 0x9989ab3bu,
+	0x4d43cfd0u, 0xbf284cd3u, 0xac78bf27u, 0x5e133c24u, 0x105ec76fu, 0xe235446cu,
+	0xf165b798u, 0x030e349bu, 0xd7c45070u, 0x25afd373u, 0x36ff2087u, 0xc494a384u,
+	0x9a879fa0u, 0x68ec1ca3u, 0x7bbcef57u, 0x89d76c54u, 0x5d1d08bfu, 0xaf768bbcu,
+	0xbc267848u, 0x4e4dfb4bu, 0x20bd8edeu, 0xd2d60dddu, 0xc186fe29u, 0x33ed7d2au,
+	0xe72719c1u, 0x154c9ac2u, 0x061c6936u, 0xf477ea35u, 0xaa64d611u, 0x580f5512u,
+	0x4b5fa6e6u, 0xb93425e5u, 0x6dfe410eu, 0x9f95c20du, 0x8cc531f9u, 0x7eaeb2fau,
+	0x30e349b1u, 0xc288cab2u, 0xd1d83946u, 0x23b3ba45u, 0xf779deaeu, 0x05125dadu,
+	0x1642ae59u, 0xe4292d5au, 0xba3a117eu, 0x4851927du, 0x5b016189u, 0xa96ae28au,
+	0x7da08661u, 0x8fcb0562u, 0x9c9bf696u, 0x6ef07595u, 0x417b1dbcu, 0xb3109ebfu,
+	0xa0406d4bu, 0x522bee48u, 0x86e18aa3u, 0x748a09a0u, 0x67dafa54u, 0x95b17957u,
+	0xcba24573u, 0x39c9c670u, 0x2a993584u, 0xd8f2b687u, 0x0c38d26cu, 0xfe53516fu,
+	0xed03a29bu, 0x1f682198u, 0x5125dad3u, 0xa34e59d0u, 0xb01eaa24u, 0x42752927u,
+	0x96bf4dccu, 0x64d4cecfu, 0x77843d3bu, 0x85efbe38u, 0xdbfc821cu, 0x2997011fu,
+	0x3ac7f2ebu, 0xc8ac71e8u, 0x1c661503u, 0xee0d9600u, 0xfd5d65f4u, 0x0f36e6f7u,
+	0x61c69362u, 0x93ad1061u, 0x80fde395u, 0x72966096u, 0xa65c047du, 0x5437877eu,
+	0x4767748au, 0xb50cf789u, 0xeb1fcbadu, 0x197448aeu, 0x0a24bb5au, 0xf84f3859u,
+	0x2c855cb2u, 0xdeeedfb1u, 0xcdbe2c45u, 0x3fd5af46u, 0x7198540du, 0x83f3d70eu,
+	0x90a324fau, 0x62c8a7f9u, 0xb602c312u, 0x44694011u, 0x5739b3e5u, 0xa55230e6u,
+	0xfb410cc2u, 0x092a8fc1u, 0x1a7a7c35u, 0xe811ff36u, 0x3cdb9bddu, 0xceb018deu,
+	0xdde0eb2au, 0x2f8b6829u, 0x82f63b78u, 0x709db87bu, 0x63cd4b8fu, 0x91a6c88cu,
+	0x456cac67u, 0xb7072f64u, 0xa457dc90u, 0x563c5f93u, 0x082f63b7u, 0xfa44e0b4u,
+	0xe9141340u, 0x1b7f9043u, 0xcfb5f4a8u, 0x3dde77abu, 0x2e8e845fu, 0xdce5075cu,
+	0x92a8fc17u, 0x60c37f14u, 0x73938ce0u, 0x81f80fe3u, 0x55326b08u, 0xa759e80bu,
+	0xb4091bffu, 0x466298fcu, 0x1871a4d8u, 0xea1a27dbu, 0xf94ad42fu, 0x0b21572cu,
+	0xdfeb33c7u, 0x2d80b0c4u, 0x3ed04330u, 0xccbbc033u, 0xa24bb5a6u, 0x502036a5u,
+	0x4370c551u, 0xb11b4652u, 0x65d122b9u, 0x97baa1bau, 0x84ea524eu, 0x7681d14du,
+	0x2892ed69u, 0xdaf96e6au, 0xc9a99d9eu, 0x3bc21e9du, 0xef087a76u, 0x1d63f975u,
+	0x0e330a81u, 0xfc588982u, 0xb21572c9u, 0x407ef1cau, 0x532e023eu, 0xa145813du,
+	0x758fe5d6u, 0x87e466d5u, 0x94b49521u, 0x66df1622u, 0x38cc2a06u, 0xcaa7a905u,
+	0xd9f75af1u, 0x2b9cd9f2u, 0xff56bd19u, 0x0d3d3e1au, 0x1e6dcdeeu, 0xec064eedu,
+	0xc38d26c4u, 0x31e6a5c7u, 0x22b65633u, 0xd0ddd530u, 0x0417b1dbu, 0xf67c32d8u,
+	0xe52cc12cu, 0x1747422fu, 0x49547e0bu, 0xbb3ffd08u, 0xa86f0efcu, 0x5a048dffu,
+	0x8ecee914u, 0x7ca56a17u, 0x6ff599e3u, 0x9d9e1ae0u, 0xd3d3e1abu, 0x21b862a8u,
+	0x32e8915cu, 0xc083125fu, 0x144976b4u, 0xe622f5b7u, 0xf5720643u, 0x07198540u,
+	0x590ab964u, 0xab613a67u, 0xb831c993u, 0x4a5a4a90u, 0x9e902e7bu, 0x6cfbad78u,
+	0x7fab5e8cu, 0x8dc0dd8fu, 0xe330a81au, 0x115b2b19u, 0x020bd8edu, 0xf0605beeu,
+	0x24aa3f05u, 0xd6c1bc06u, 0xc5914ff2u, 0x37faccf1u, 0x69e9f0d5u, 0x9b8273d6u,
+	0x88d28022u, 0x7ab90321u, 0xae7367cau, 0x5c18e4c9u, 0x4f48173du, 0xbd23943eu,
+	0xf36e6f75u, 0x0105ec76u, 0x12551f82u, 0xe03e9c81u, 0x34f4f86au, 0xc69f7b69u,
+	0xd5cf889du, 0x27a40b9eu, 0x79b737bau, 0x8bdcb4b9u, 0x988c474du, 0x6ae7c44eu,
+	0xbe2da0a5u, 0x4c4623a6u, 0x5f16d052u, 0xad7d5351u
+};
+
+static uint32_t crc32c_sw(const char *s, size_t len) {
+uint32_t c = 0xffffffffu;
+size_t i;
+
+  for(i=0; i<len; i++)
+	c = crc32c_table[(c ^ (unsigned char)s[i]) & 0xff] ^ (c >> 8);
+  return ~c;
+}
+
+#ifdef HAVE_CRC32_INSN
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(const char *s, size_t len) {
+uint64_t c = 0xffffffffu;
+size_t i;
+
+  for(i=0; i+8 <= len; i+=8)
+	c = _mm_crc32_u64(c, load64(s+i));
+  for(; i<len; i++)
+	c = _mm_crc32_u8((uint32_t)c, (unsigned char)s[i]);
+  return ~(uint32_t)c;
+}
+#endif
+
+#ifdef HAVE_CRC32_INSN
+// resolved once at load time, before any thread can hash
+static int have_sse42;
+
+__attribute__((constructor))
+static void detect_sse42(void) {
+  __builtin_cpu_init();
+  have_sse42 = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+}
+#endif
+
+static unsigned h_crc32c(char *s) {
+#ifdef HAVE_CRC32_INSN
+  if(have_sse42)
+	return crc32c_hw(s, strlen(s));
+#endif
+  return crc32c_sw(s, strlen(s));
+}
 /******** END LIBRARY SUPPLIED HASH FUNCTIONS *****/
 
 
@@ -67,7 +346,10 @@ unsigned h=0;
 static HFUNC_STRUCT HashFunctions[] = 
 	{ 
 		{h0, "naive char sum"},
-		{h1, "weighted char sum"}
+		{h1, "weighted char sum"},
+		{h_fnv1a, "FNV-1a 64 (folded)"},
+		{h_wymix, "wyhash-style 64 bit mixer (folded)"},
+		{h_crc32c, "CRC32C"}
 	};
 
 
@@ -76,34 +358,129 @@ static int NumHFuncs = sizeof(HashFunctions)/sizeof(HFUNC_STRUCT);
 /***** END GLOBALS ******/
 
 /***** FORWARD DECLARATIONS *****/
-static int match(char *key, unsigned hval, NODE_HMAP *p); 
-static NODE_HMAP **get_node_pred(HMAP_PTR map, char *key); 
+static int match(char *key, unsigned len, unsigned hval, NODE_HMAP *p); 
+static NODE_HMAP **get_node_pred(HMAP_PTR map, char *key, unsigned len, 
+				unsigned h); 
 static TBL_ENTRY *create_tbl_array(int tsize); 
 static void resize(HMAP_PTR map); 
-static void free_lst(NODE_HMAP *l, int free_vals); 
+static void rebuild(HMAP_PTR map, int ntsize);
+static TBL_ENTRY *bucket_for(HMAP_PTR map, unsigned h);
+static void migrate_step(HMAP_PTR map, int nbuckets);
+static void finish_migration(HMAP_PTR map);
+static void chained_stats(HMAP_PTR map, HMAP_STATS *st);
+static void flat_stats(HMAP_PTR map, HMAP_STATS *st);
+static uint64_t bloom_mix(unsigned h);
+static uint64_t bloom_bits(uint64_t x);
+static void bloom_add(HMAP_PTR map, unsigned h);
+static int bloom_test(uint64_t *bloom, unsigned mask, unsigned h);
+static int bloom_maybe(HMAP_PTR map, unsigned h);
+static unsigned bloom_nblocks(HMAP_PTR map);
+static void bloom_alloc(HMAP_PTR map, unsigned nblocks);
+static void bloom_fit(HMAP_PTR map);
+static void drop_old_bloom(HMAP_PTR map);
+static void bloom_removed(HMAP_PTR map);
+static int frozen_bucket(HMAP_FROZEN_PTR fm, uint64_t h);
+static int frozen_slot(HMAP_FROZEN_PTR fm, uint64_t h, uint32_t pilot);
+static int frozen_find(HMAP_FROZEN_PTR fm, char *key);
+static int frozen_build(HMAP_FROZEN_PTR fm, char **keys, unsigned *lens,
+			int *slot_of);
+static void free_lst(HMAP_PTR map, NODE_HMAP *l, int free_vals); 
+static void flat_free_slots(HMAP_PTR map, int free_vals);
+static void free_slabs(HMAP_PTR map, int keep_newest);
 static void add_front(TBL_ENTRY *entry, NODE_HMAP *p);
+
+static void *arena_alloc(HMAP_PTR map, size_t nbytes);
+static int key_class(size_t len);
+static char *clone_key(HMAP_PTR map, char *key, unsigned len);
+static void release_key(HMAP_PTR map, char *key, unsigned len);
+static void store_key(HMAP_PTR map, KEY_STORE *k, char *key, unsigned len);
+static void drop_key(HMAP_PTR map, KEY_STORE *k, unsigned len);
+static NODE_HMAP *alloc_node(HMAP_PTR map);
+static void release_node(HMAP_PTR map, NODE_HMAP *p);
+
+static unsigned flat_mix(unsigned h);
+static unsigned group_match(const signed char *g, signed char c);
+static unsigned group_free(const signed char *g);
+static int flat_find(HMAP_PTR map, char *key, unsigned len, unsigned h);
+static int flat_find_free(HMAP_PTR map, unsigned h);
+static int flat_probe_len(HMAP_PTR map, unsigned g, int target);
+static void flat_alloc(HMAP_PTR map, int tsize);
+static void flat_rehash(HMAP_PTR map, int ntsize);
+static int flat_insert(HMAP_PTR map, char *key, unsigned len, void *val, 
+			unsigned h);
 /***** END FORWARD DECLARATIONS *****/
 
 
 /***** BEGIN hmap FUNCTIONS ******/
 
 HMAP_PTR hmap_create(unsigned init_tsize, double lfactor){
+  return hmap_create_ex(init_tsize, lfactor, HMAP_CHAINED);
+}
+
+HMAP_PTR hmap_create_ex(unsigned init_tsize, double lfactor, int flags){
 HMAP_PTR map = malloc(sizeof(struct hmap));
+int i;
 
   map->n = 0;
+  map->nresizes = 0;
+  map->nbytes = sizeof(struct hmap);
+  map->engine = (flags & HMAP_FLAT) ? HMAP_FLAT : HMAP_CHAINED;
+  map->use_arena = (flags & HMAP_ARENA) ? 1 : 0;
+  map->incremental = (flags & HMAP_INCREMENTAL) ? 1 : 0;
+  map->bloom = NULL;
+  map->bloom_base = NULL;
+  map->bloom_mask = 0;
+  map->old_bloom = NULL;
+  map->bloom_stale = 0;
+  map->old_tbl = NULL;
+  map->old_tsize = 0;
+  map->migrate_pos = 0;
+  map->migrate_nbuckets = HMAP_MIGRATE_STEP;
+  map->slabs = NULL;
+  map->free_nodes = NULL;
+  for(i=0; i<KEY_CLASSES; i++)
+	map->free_keys[i] = NULL;
   if(lfactor <= 0)
 	lfactor = DEFAULT_LFACTOR;
   if(init_tsize <= 0)
 	init_tsize = DEFAULT_INIT_SIZE;
   
+  map->hfunc = HashFunctions[DEFAULT_HFUNC_ID].hfunc;
+  map->hfunc_desc = HashFunctions[DEFAULT_HFUNC_ID].description;
+
+  map->tbl = NULL;
+  map->ctrl = NULL;
+  map->slots = NULL;
+  map->ndeleted = 0;
+
+  if(map->engine == HMAP_FLAT) {
+     unsigned tsize = GROUP_SIZE;
+
+     if(lfactor > HMAP_FLAT_MAX_LFACTOR)
+	lfactor = HMAP_FLAT_MAX_LFACTOR;
+     while(tsize < init_tsize)
+	tsize *= 2;
+     map->lfactor = lfactor;
+     flat_alloc(map, tsize);
+     if(flags & HMAP_BLOOM)
+	bloom_fit(map);
+     return map;
+  }
   map->lfactor = lfactor;
   map->tsize = init_tsize;
   map->max_n = init_tsize * lfactor;
-
-  map->hfunc = HashFunctions[DEFAULT_HFUNC_ID].hfunc;
-  map->hfunc_desc = HashFunctions[DEFAULT_HFUNC_ID].description;
+  // a doubling from t buckets is followed by about t*lfactor
+  //   inserts before the next one, so moving more than 
+  //   1/lfactor buckets per operation finishes each migration 
+  //   in time even at low load factors
+  map->migrate_nbuckets = (int)(1 / lfactor) + 2;
+  if(map->migrate_nbuckets < HMAP_MIGRATE_STEP)
+	map->migrate_nbuckets = HMAP_MIGRATE_STEP;
 
   map->tbl = create_tbl_array(init_tsize);
+  map->nbytes += init_tsize * sizeof(TBL_ENTRY);
+  if(flags & HMAP_BLOOM)
+     bloom_fit(map);
  
   return map;
 }
@@ -116,6 +493,17 @@ int hmap_size(HMAP_PTR map) {
 void hmap_display(HMAP_PTR map) {
 int i, j;
   
+  if(map->engine == HMAP_FLAT) {  // one row per control group
+    for(i=0; i<map->tsize; i+=GROUP_SIZE) {
+      printf("|-|");
+      for(j=i; j<i+GROUP_SIZE; j++)
+	  if(map->ctrl[j] >= 0)
+	     printf("X");
+      printf("\n");
+    }
+    return;
+  }
+  finish_migration(map);
   for(i=0; i<map->tsize; i++) {
       printf("|-|");
       for(j=0; j<map->tbl[i].n; j++) 
@@ -139,6 +527,35 @@ int hmap_set_hfunc(HMAP_PTR map, int hfunc_id) {
   return 1;
 }
 
+HFUNC hmap_builtin_hfunc(int hfunc_id) {
+  if(hfunc_id < 0 || hfunc_id >= NumHFuncs)
+	return NULL;
+  return HashFunctions[hfunc_id].hfunc;
+}
+
+double hmap_hfunc_quality(HMAP_PTR map) {
+double sum = 0.0, expected;
+int i, *counts = NULL;
+
+  if(map->n == 0)
+	return 0.0;
+  finish_migration(map);
+  if(map->engine == HMAP_FLAT) {  // no chains; bucket the raw hashes
+    counts = calloc(map->tsize, sizeof(int));
+    for(i=0; i<map->tsize; i++)
+	if(map->ctrl[i] >= 0)
+	   counts[map->slots[i].hval % map->tsize]++;
+  }
+  for(i=0; i<map->tsize; i++) {
+    double c = counts ? counts[i] : map->tbl[i].n;
+    sum += c*(c+1)/2;
+  }
+  free(counts);
+  // expected value of sum for a uniform random hash
+  expected = (map->n / (2.0*map->tsize)) * (map->n + 2.0*map->tsize - 1);
+  return sum / expected;
+}
+
 int hmap_set_user_hfunc(HMAP_PTR map, HFUNC hfunc, char *desc) {
   if(map->n > 0) {
 	fprintf(stderr, 
@@ -155,121 +572,445 @@ int hmap_set_user_hfunc(HMAP_PTR map, HFUNC hfunc, char *desc) {
 
 
 
+unsigned hmap_hash(HMAP_PTR map, char *key) {
+  return map->hfunc(key);
+}
+
 int hmap_contains(HMAP_PTR map, char *key) {
-NODE_HMAP **pp;
-  pp = get_node_pred(map, key);
-  return (*pp == NULL ? 0 : 1);
+  return hmap_contains_h(map, key, strlen(key), map->hfunc(key));
 }
 
 void *hmap_get(HMAP_PTR map, char *key) {
-NODE_HMAP **pp;
-  pp = get_node_pred(map, key);
-  return (*pp == NULL ? NULL : (*pp)->val);
+  return hmap_get_h(map, key, strlen(key), map->hfunc(key));
 }
 
-  
+void * hmap_set(HMAP_PTR map, char *key, void *val){
+  return hmap_set_h(map, key, strlen(key), map->hfunc(key), val);
+}
 
-	
+void **hmap_upsert(HMAP_PTR map, char *key, int *inserted) {
+  return hmap_upsert_h(map, key, strlen(key), map->hfunc(key), inserted);
+}
 
-  
+int hmap_contains_h(HMAP_PTR map, char *key, unsigned len, unsigned hval) {
+NODE_HMAP **pp;
+  if(map->bloom != NULL && !bloom_maybe(map, hval))
+     return 0;
+  if(map->engine == HMAP_FLAT)
+     return flat_find(map, key, len, hval) >= 0;
+  migrate_step(map, map->migrate_nbuckets);
+  pp = get_node_pred(map, key, len, hval);
+  return (*pp == NULL ? 0 : 1);
+}
 
-void * hmap_set(HMAP_PTR map, char *key, void *val){
-unsigned h;
-int idx;
-NODE_HMAP *p, **pp;
+void *hmap_get_h(HMAP_PTR map, char *key, unsigned len, unsigned hval) {
+NODE_HMAP **pp;
+  if(map->bloom != NULL && !bloom_maybe(map, hval))
+     return NULL;
+  if(map->engine == HMAP_FLAT) {
+     int i = flat_find(map, key, len, hval);
+     return (i < 0 ? NULL : map->slots[i].val);
+  }
+  migrate_step(map, map->migrate_nbuckets);
+  pp = get_node_pred(map, key, len, hval);
+  return (*pp == NULL ? NULL : (*pp)->val);
+}
 
-  pp = get_node_pred(map, key);
-  p = *pp;
+void *hmap_set_h(HMAP_PTR map, char *key, unsigned len, unsigned hval, 
+		void *val) {
+void **slot, *tmp;
 
-  if(p == NULL) {  // key not present
-     char *key_clone;
+  // a new key's slot starts out NULL, so that is what we return
+  slot = hmap_upsert_h(map, key, len, hval, NULL);
+  tmp = *slot;
+  *slot = val;
+  return tmp;
+}
+
+void **hmap_upsert_h(HMAP_PTR map, char *key, unsigned len, unsigned hval,
+		int *inserted) {
+int idx, is_new;
+int absent = (map->bloom != NULL && !bloom_maybe(map, hval));
+NODE_HMAP *p;
 
-     key_clone = malloc( (strlen(key) + 1)*sizeof(char));
-     strcpy(key_clone, key);
+  if(map->engine == HMAP_FLAT) {
+     idx = absent ? -1 : flat_find(map, key, len, hval);
+     is_new = (idx < 0);
+     if(is_new)
+        idx = flat_insert(map, key, len, NULL, hval);
+     if(inserted != NULL)
+	*inserted = is_new;
+     return &(map->slots[idx].val);
+  }
+  migrate_step(map, map->migrate_nbuckets);
+  p = absent ? NULL : *get_node_pred(map, key, len, hval);
+  is_new = (p == NULL);
 
+  if(is_new) {  // key not present
      map->n++;
      if(map->n > map->max_n) 
 	resize(map);
-     h = map->hfunc(key);
-     idx = h % map->tsize;
 
-     p = malloc(sizeof(NODE_HMAP));
+     p = alloc_node(map);
 
-     p->key = key_clone;
-     p->val = val;
-     p->hval = h;
+     store_key(map, &p->k, key, len);
+     p->klen = len;
+     p->val = NULL;
+     p->hval = hval;
 
-     add_front(&(map->tbl[idx]), p);
-     return NULL;  // no old value to return
+     add_front(bucket_for(map, hval), p);
+     if(map->bloom != NULL)
+	bloom_add(map, hval);
   }
-  else {  // key already in map
-     void *tmp = p->val;
-     p->val = val;
-     return tmp;  // return old value
+  if(inserted != NULL)
+     *inserted = is_new;
+  return &(p->val);
+}
+
+
+int hmap_get_batch(HMAP_PTR map, char **keys, int nkeys, void **vals) {
+unsigned h[BATCH_WINDOW], len[BATCH_WINDOW];
+NODE_HMAP *first[BATCH_WINDOW];
+int base, w, i, found = 0;
+
+  migrate_step(map, map->migrate_nbuckets);
+  for(base=0; base<nkeys; base+=BATCH_WINDOW) {
+    w = nkeys - base < BATCH_WINDOW ? nkeys - base : BATCH_WINDOW;
+
+    // stage 1:  hash everything, prefetch home buckets/groups
+    for(i=0; i<w; i++) {
+	len[i] = strlen(keys[base+i]);
+	h[i] = map->hfunc(keys[base+i]);
+	if(map->engine == HMAP_FLAT) {
+	   unsigned g = (flat_mix(h[i]) >> 7) & (map->tsize/GROUP_SIZE - 1);
+	   PREFETCH(map->ctrl + g*GROUP_SIZE);
+	   PREFETCH(map->slots + g*GROUP_SIZE);
+	}
+	else
+	   PREFETCH(bucket_for(map, h[i]));
+    }
+    // stage 2:  prefetch the first candidate node/slot
+    for(i=0; i<w; i++) {
+	if(map->engine == HMAP_FLAT) {
+	   unsigned m = flat_mix(h[i]);
+	   unsigned g = (m >> 7) & (map->tsize/GROUP_SIZE - 1);
+	   unsigned bits = group_match(map->ctrl + g*GROUP_SIZE, 
+					(signed char)(m & 0x7f));
+	   first[i] = NULL;
+	   if(bits)
+		PREFETCH(map->slots + g*GROUP_SIZE + __builtin_ctz(bits));
+	}
+	else {
+	   first[i] = bucket_for(map, h[i])->members;
+	   if(first[i] != NULL)
+		PREFETCH(first[i]);
+	}
+    }
+    // stage 3:  prefetch the stored key of the first node
+    if(map->engine != HMAP_FLAT)
+      for(i=0; i<w; i++)
+	if(first[i] != NULL && !IS_INLINE(first[i]->klen))
+	   PREFETCH(first[i]->k.ptr);
+    // stage 4:  resolve; the lines should be in cache now
+    for(i=0; i<w; i++) {
+	if(map->bloom != NULL && !bloom_maybe(map, h[i]))
+	   vals[base+i] = NULL;
+	else if(map->engine == HMAP_FLAT) {
+	   int idx = flat_find(map, keys[base+i], len[i], h[i]);
+	   vals[base+i] = (idx < 0 ? NULL : map->slots[idx].val);
+	   found += (idx >= 0);
+	}
+	else {
+	   NODE_HMAP *p = *get_node_pred(map, keys[base+i], len[i], h[i]);
+	   vals[base+i] = (p == NULL ? NULL : p->val);
+	   found += (p != NULL);
+	}
+    }
   }
+  return found;
 }
 
 
 void *hmap_remove(HMAP_PTR map, char *key) {
 NODE_HMAP *p, **pp;
+unsigned len = strlen(key);
+unsigned h = map->hfunc(key);
+
+  if(map->bloom != NULL && !bloom_maybe(map, h))
+     return NULL;
+  if(map->engine == HMAP_FLAT) {
+     int i = flat_find(map, key, len, h);
+     void *val;
 
-  pp = get_node_pred(map, key);
+     if(i < 0)
+	return NULL;
+     val = map->slots[i].val;
+     drop_key(map, &map->slots[i].k, len);
+     map->ctrl[i] = CTRL_DELETED;
+     map->ndeleted++;
+     map->n--;
+     if(map->bloom != NULL)
+	bloom_removed(map);
+     return val;
+  }
+  migrate_step(map, map->migrate_nbuckets);
+  pp = get_node_pred(map, key, len, h);
   p = *pp;
   if(p == NULL){
 	return NULL;
   }
   else {
-	unsigned idx;
 	void *val = p->val;
 
 	*pp = p->next;  // make predecessor skip node
 			//   being removed
-	free(p->key);
-	free(p);
+	bucket_for(map, p->hval)->n--;
+	drop_key(map, &p->k, len);
+	release_node(map, p);
 
-  	idx = (p->hval) % map->tsize;
-	map->tbl[idx].n--;
 	map->n--;
+	if(map->bloom != NULL)
+	   bloom_removed(map);
 	return val;
   }
 }
   
 
 
+void hmap_get_stats(HMAP_PTR map, HMAP_STATS *st) {
+int i;
+
+  finish_migration(map);
+  st->engine = (map->engine == HMAP_FLAT ? "flat" : "chained");
+  st->hfunc_desc = map->hfunc_desc;
+  st->n = map->n;
+  st->tsize = map->tsize;
+  st->load_factor = (double)map->n / map->tsize;
+  for(i=0; i<HMAP_HIST_SIZE; i++)
+	st->chain_hist[i] = 0;
+  st->max_chain = 0;
+  st->mean_probe_hit = 0.0;
+  st->max_probe_hit = 0;
+  st->mean_probe_miss = 0.0;
+  st->max_probe_miss = 0;
+  if(map->engine == HMAP_FLAT)
+	flat_stats(map, st);
+  else
+	chained_stats(map, st);
+  st->nresizes = map->nresizes;
+  st->bytes_allocated = map->nbytes;
+  st->hfunc_quality = hmap_hfunc_quality(map);
+}
+
 void hmap_print_stats(HMAP_PTR map) {
+HMAP_STATS st;
+int i;
 
-    printf("sorry, hmap_print_stats() not implemented\n");
+  hmap_get_stats(map, &st);
+  printf("engine:          %s\n", st.engine);
+  printf("hash function:   %s\n", st.hfunc_desc);
+  printf("keys:            %i\n", st.n);
+  printf("table size:      %i\n", st.tsize);
+  printf("load factor:     %.3f (max %.3f)\n", st.load_factor, map->lfactor);
+  printf("resizes:         %i\n", st.nresizes);
+  printf("bytes allocated: %lu\n", (unsigned long)st.bytes_allocated);
+  printf("hash quality:    %.3f (1.0 is ideal)\n", st.hfunc_quality);
+  printf("probes (hit):    mean %.3f  max %i\n", 
+	st.mean_probe_hit, st.max_probe_hit);
+  printf("probes (miss):   mean %.3f  max %i\n", 
+	st.mean_probe_miss, st.max_probe_miss);
+  printf("longest chain:   %i\n", st.max_chain);
+  printf("chain length histogram:\n");
+  for(i=0; i<HMAP_HIST_SIZE; i++) {
+	if(st.chain_hist[i] == 0) continue;
+	printf("  %2i%s %i\n", i, 
+	  (i == HMAP_HIST_SIZE-1 ? "+:" : ": "), st.chain_hist[i]);
+  }
+}
 
+void hmap_clear(HMAP_PTR map, int free_vals) {
+int i;
+
+  if(map->engine == HMAP_FLAT) {
+    flat_free_slots(map, free_vals);
+    memset(map->ctrl, CTRL_EMPTY, map->tsize);
+    map->ndeleted = 0;
+  }
+  else {
+    finish_migration(map);
+    for(i=0; i<map->tsize; i++) {
+	free_lst(map, map->tbl[i].members, free_vals);
+	map->tbl[i].members = NULL;
+	map->tbl[i].n = 0;
+    }
+  }
+  free_slabs(map, 1);
+  map->n = 0;
+  if(map->bloom != NULL)
+    bloom_fit(map);
+}
+
+void hmap_reserve(HMAP_PTR map, int n) {
+int ntsize;
+
+  if(map->engine == HMAP_FLAT) {
+    // leave room for the n keys plus no tombstones
+    for(ntsize=map->tsize; (int)(ntsize * map->lfactor) < n; ntsize *= 2)
+	;
+    if(ntsize > map->tsize)
+	flat_rehash(map, ntsize);
+    return;
+  }
+  ntsize = (int)(n / map->lfactor) + 1;
+  if(ntsize > map->tsize) {
+    finish_migration(map);
+    rebuild(map, ntsize);
+  }
 }
 
 void hmap_free(HMAP_PTR map, int free_vals) {
 int i;
 
-  for(i=0; i<map->tsize; i++) 
-	free_lst(map->tbl[i].members, free_vals);
-  free(map->tbl);
+  if(map->engine == HMAP_FLAT) {
+    flat_free_slots(map, free_vals);
+    free(map->ctrl);
+    free(map->slots);
+  }
+  else {
+    finish_migration(map);
+    for(i=0; i<map->tsize; i++) 
+	free_lst(map, map->tbl[i].members, free_vals);
+    free(map->tbl);
+  }
+  free_slabs(map, 0);
+  free(map->bloom_base);
   map->tbl = NULL;  // not needed
   free(map);
 }
 
+/***** END hmap FUNCTIONS ******/
+
+
+/***** BEGIN frozen hmap FUNCTIONS ******/
+
+HMAP_FROZEN_PTR hmap_freeze(HMAP_PTR map) {
+HMAP_FROZEN_PTR fm = malloc(sizeof(struct hmap_frozen));
+char **keys = malloc((map->n + 1) * sizeof(char *));
+unsigned *lens = malloc((map->n + 1) * sizeof(unsigned));
+void **vals = malloc((map->n + 1) * sizeof(void *));
+int *slot_of = malloc((map->n + 1) * sizeof(int));
+int *key_at;
+uint32_t off = 0;
+NODE_HMAP *p;
+size_t nbytes = 0;
+int i, k = 0, attempt;
+
+  // gather all entries
+  finish_migration(map);
+  if(map->engine == HMAP_FLAT) {
+    for(i=0; i<map->tsize; i++)
+	if(map->ctrl[i] >= 0) {
+	   keys[k] = KEY_OF(&map->slots[i]);
+	   lens[k] = map->slots[i].klen;
+	   vals[k++] = map->slots[i].val;
+	}
+  }
+  else {
+    for(i=0; i<map->tsize; i++)
+	for(p=map->tbl[i].members; p != NULL; p=p->next) {
+	   keys[k] = KEY_OF(p);
+	   lens[k] = p->klen;
+	   vals[k++] = p->val;
+	}
+  }
+  fm->n = k;
+  fm->m = (int)(k / FROZEN_ALPHA) | 1;   // odd:  see frozen_slot
+  fm->nbuckets = k/FROZEN_BUCKET_LOAD + 2;
+  fm->ndense = (int)(fm->nbuckets * FROZEN_DENSE_BUCKETS) + 1;
+  fm->pilots = malloc(fm->nbuckets * sizeof(uint32_t));
+  fm->remap = malloc((fm->m - k + 1) * sizeof(uint32_t));
+
+  // a seed fails only if two keys collide on all 64 hash bits
+  //   or some bucket needs an absurd pilot; try a few others.
+  for(attempt=0; ; attempt++) {
+    if(attempt == FROZEN_MAX_ATTEMPTS) {
+	free(fm->pilots);
+	free(fm->remap);
+	free(fm);
+	free(keys);
+	free(lens);
+	free(vals);
+	free(slot_of);
+	return NULL;
+    }
+    fm->seed = 0x9e3779b97f4a7c15ull * (attempt + 1);
+    if(frozen_build(fm, keys, lens, slot_of))
+	break;
+  }
+
+  // pack keys and values in slot order
+  fm->vals = malloc((k + 1) * sizeof(void *));
+  fm->key_off = malloc((k + 1) * sizeof(uint32_t));
+  for(i=0; i<k; i++)
+    nbytes += lens[i];
+  fm->blob = malloc(nbytes + 1);
+  key_at = malloc((k + 1) * sizeof(int));
+  for(i=0; i<k; i++)
+    key_at[slot_of[i]] = i;
+  for(i=0; i<k; i++) {
+    fm->key_off[i] = off;
+    memcpy(fm->blob + off, keys[key_at[i]], lens[key_at[i]]);
+    off += lens[key_at[i]];
+    fm->vals[i] = vals[key_at[i]];
+  }
+  fm->key_off[k] = off;
+  free(key_at);
+  free(keys);
+  free(lens);
+  free(vals);
+  free(slot_of);
+  return fm;
+}
+
+int hmap_frozen_size(HMAP_FROZEN_PTR fm) {
+  return fm->n;
+}
+
+int hmap_frozen_contains(HMAP_FROZEN_PTR fm, char *key) {
+  return frozen_find(fm, key) >= 0;
+}
+
+void *hmap_frozen_get(HMAP_FROZEN_PTR fm, char *key) {
+int i = frozen_find(fm, key);
+  return (i < 0 ? NULL : fm->vals[i]);
+}
+
+void hmap_frozen_free(HMAP_FROZEN_PTR fm) {
+  free(fm->pilots);
+  free(fm->remap);
+  free(fm->key_off);
+  free(fm->blob);
+  free(fm->vals);
+  free(fm);
+}
+
+/***** END frozen hmap FUNCTIONS ******/
+
 
 
 /**** UTILITY FUNCTIONS *******/
 
-static int match(char *key, unsigned hval, NODE_HMAP *p) {
-  return (p->hval == hval && strcmp(key, p->key)==0);
+static int match(char *key, unsigned len, unsigned hval, NODE_HMAP *p) {
+  return (p->hval == hval && p->klen == len && memcmp(key, KEY_OF(p), len)==0);
 }
 
-static NODE_HMAP **get_node_pred(HMAP_PTR map, char *key) {
-unsigned h;
-int i;
+static NODE_HMAP **get_node_pred(HMAP_PTR map, char *key, unsigned len, 
+				unsigned h) {
 NODE_HMAP **pp;
-  h = map->hfunc(key);
-  i = h % map->tsize;
 
-  pp =&(map->tbl[i].members); 
+  pp =&(bucket_for(map, h)->members); 
   while( *pp != NULL) {
-    if(match(key, h, *pp)) 
+    if(match(key, len, h, *pp)) 
 	return pp;
     pp = &((*pp)->next);
   }
@@ -282,27 +1023,50 @@ static void add_front(TBL_ENTRY *entry, NODE_HMAP *p) {
   entry->members = p;
 }
 
+// an empty table:  calloc, so large tables come straight from
+//   zeroed pages instead of being written entry by entry
 static TBL_ENTRY *create_tbl_array(int tsize) {
-int i;
-TBL_ENTRY *tbl;
-NODE_HMAP *p;
-
-  tbl = malloc(tsize * sizeof(TBL_ENTRY));
-  for(i=0; i<tsize; i++) {
-	tbl[i].members = NULL;
-	tbl[i].n = 0;
-  }
-  return tbl;
+  return calloc(tsize, sizeof(TBL_ENTRY));
 }
 
 static void resize(HMAP_PTR map) {
 int ntsize;
+
+  ntsize = 2*map->tsize;
+  if(map->incremental) {
+    finish_migration(map);  // at most one migration in flight
+    map->nresizes++;
+    map->nbytes += ntsize * sizeof(TBL_ENTRY);
+    map->old_tbl = map->tbl;
+    map->old_tsize = map->tsize;
+    map->migrate_pos = 0;
+    map->tbl = create_tbl_array(ntsize);
+    map->tsize = ntsize;
+    map->max_n = (int)(ntsize * map->lfactor);
+    if(map->bloom != NULL) {
+	// the old filter keeps answering for unmigrated buckets; keys
+	//   enter the (empty) new one as they are inserted or migrated
+	map->old_bloom = map->bloom;
+	map->old_bloom_base = map->bloom_base;
+	map->old_bloom_mask = map->bloom_mask;
+	map->bloom = NULL;
+	map->bloom_base = NULL;
+	bloom_alloc(map, bloom_nblocks(map));
+    }
+    return;
+  }
+  rebuild(map, ntsize);
+}
+
+// relinks every node into a new table of ntsize entries
+//   (no migration may be in progress)
+static void rebuild(HMAP_PTR map, int ntsize) {
 TBL_ENTRY *ntbl;
 NODE_HMAP *nxt, *p;
-unsigned h;
 int i, idx;
 
-  ntsize = 2*map->tsize;
+  map->nresizes++;
+  map->nbytes += ntsize * sizeof(TBL_ENTRY);
   ntbl = create_tbl_array(ntsize);
 
   for(i=0; i<map->tsize; i++) {
@@ -316,20 +1080,709 @@ int i, idx;
     }
   }
   free(map->tbl);
+  map->nbytes -= map->tsize * sizeof(TBL_ENTRY);
   map->tbl = ntbl;
   map->tsize = ntsize;
   map->max_n = (int)(ntsize * map->lfactor);
+  if(map->bloom != NULL)
+    bloom_fit(map);
+}
+// the bucket that currently owns hash value h:  the old table's
+//   bucket if it has not been migrated yet, else the new one.
+static TBL_ENTRY *bucket_for(HMAP_PTR map, unsigned h) {
+  if(map->old_tbl != NULL) {
+    int oi = h % map->old_tsize;
+    if(oi >= map->migrate_pos)
+	return &map->old_tbl[oi];
+  }
+  return &map->tbl[h % map->tsize];
+}
+
+// moves up to nbuckets old buckets into the new table
+static void migrate_step(HMAP_PTR map, int nbuckets) {
+NODE_HMAP *nxt, *p;
+
+  if(map->old_tbl == NULL)
+    return;
+  while(nbuckets-- > 0 && map->migrate_pos < map->old_tsize) {
+    p = map->old_tbl[map->migrate_pos].members;
+    while(p != NULL) {
+	nxt = p->next;
+	add_front(&map->tbl[p->hval % map->tsize], p);
+	if(map->old_bloom != NULL)
+	   bloom_add(map, p->hval);
+	p = nxt;
+    }
+    map->migrate_pos++;
+  }
+  if(map->migrate_pos == map->old_tsize) {
+    free(map->old_tbl);
+    map->nbytes -= map->old_tsize * sizeof(TBL_ENTRY);
+    map->old_tbl = NULL;
+    if(map->old_bloom != NULL)
+	drop_old_bloom(map);
+  }
+}
 
+static void finish_migration(HMAP_PTR map) {
+  if(map->old_tbl != NULL)
+    migrate_step(map, map->old_tsize);
 }
-static void free_lst(NODE_HMAP *l, int free_vals) {
-  if(l == NULL) return;
-  free_lst(l->next, free_vals );
-  free(l->key);  // made our own copy
-  if(free_vals &&  l->val != NULL)
+
+static void chained_stats(HMAP_PTR map, HMAP_STATS *st) {
+NODE_HMAP *p;
+long hit_probes = 0;
+int i, k;
+
+  for(i=0; i<map->tsize; i++) {
+    int c = map->tbl[i].n;
+
+    st->chain_hist[c < HMAP_HIST_SIZE ? c : HMAP_HIST_SIZE-1]++;
+    if(c > st->max_chain)
+	st->max_chain = c;
+    for(k=1, p=map->tbl[i].members; p != NULL; k++, p=p->next)
+	hit_probes += k;   // k-th node found after k compares
+  }
+  if(map->n > 0)
+    st->mean_probe_hit = (double)hit_probes / map->n;
+  st->max_probe_hit = st->max_chain;
+  // a miss compares against every node in its chain
+  st->mean_probe_miss = (double)map->n / map->tsize;
+  st->max_probe_miss = st->max_chain;
+}
+
+// iterative so that long chains cannot overflow the stack.
+// In arena mode nodes and keys are reclaimed with the slabs
+//   (see free_slabs), so only values need the walk.
+static void free_lst(HMAP_PTR map, NODE_HMAP *l, int free_vals) {
+NODE_HMAP *nxt;
+
+  if(map->use_arena && !free_vals) 
+    return;
+  for(; l != NULL; l = nxt) {
+    nxt = l->next;
+    if(free_vals &&  l->val != NULL)
 	free(l->val);
-  free(l);
+    if(!map->use_arena) {
+	drop_key(map, &l->k, l->klen);  // made our own copy
+	release_node(map, l);
+    }
+  }
 }
 /**** END UTILITY FUNCTIONS *******/
 
+/**** ALLOCATION UTILITY FUNCTIONS *******/
+
+// bump-allocates from the newest slab; nbytes must be a 
+//   multiple of KEY_ALIGN so every chunk stays pointer-aligned.
+static void *arena_alloc(HMAP_PTR map, size_t nbytes) {
+SLAB *s = map->slabs;
+void *mem;
+
+  if(s == NULL || s->used + nbytes > s->cap) {
+    size_t cap = nbytes > SLAB_SIZE ? nbytes : SLAB_SIZE;
+
+    s = malloc(sizeof(SLAB) + cap);
+    map->nbytes += sizeof(SLAB) + cap;
+    s->used = 0;
+    s->cap = cap;
+    s->next = map->slabs;
+    map->slabs = s;
+  }
+  mem = (char *)(s + 1) + s->used;
+  s->used += nbytes;
+  return mem;
+}
+
+// size class of a key buffer holding len chars plus the nul
+static int key_class(size_t len) {
+  return (int)((len + KEY_ALIGN) / KEY_ALIGN) - 1;
+}
+
+// copies the len bytes at key and nul-terminates the copy
+static char *clone_key(HMAP_PTR map, char *key, unsigned len) {
+char *key_clone;
+int c;
+
+  if(!map->use_arena) {
+    key_clone = malloc( (len + 1)*sizeof(char));
+    map->nbytes += len + 1;
+  }
+  else {
+    c = key_class(len);
+    if(c < KEY_CLASSES && map->free_keys[c] != NULL) {
+	key_clone = (char *)map->free_keys[c];
+	map->free_keys[c] = map->free_keys[c]->next;
+    }
+    else
+	key_clone = arena_alloc(map, (size_t)(c+1)*KEY_ALIGN);
+  }
+  memcpy(key_clone, key, len);
+  key_clone[len] = '\0';
+  return key_clone;
+}
+
+static void release_key(HMAP_PTR map, char *key, unsigned len) {
+int c;
+FREE_CHUNK *chunk;
+
+  if(!map->use_arena) {
+    map->nbytes -= len + 1;
+    free(key);
+    return;
+  }
+  c = key_class(len);
+  if(c < KEY_CLASSES) {
+    chunk = (FREE_CHUNK *)key;
+    chunk->next = map->free_keys[c];
+    map->free_keys[c] = chunk;
+  }
+}
+
+// copies key into k:  inline if short, else a clone
+static void store_key(HMAP_PTR map, KEY_STORE *k, char *key, unsigned len) {
+  if(IS_INLINE(len)) {
+    memcpy(k->bytes, key, len);
+    k->bytes[len] = '\0';
+  }
+  else
+    k->ptr = clone_key(map, key, len);
+}
+
+static void drop_key(HMAP_PTR map, KEY_STORE *k, unsigned len) {
+  if(!IS_INLINE(len))
+    release_key(map, k->ptr, len);
+}
+
+static NODE_HMAP *alloc_node(HMAP_PTR map) {
+NODE_HMAP *p;
+
+  if(!map->use_arena) {
+    map->nbytes += sizeof(NODE_HMAP);
+    return malloc(sizeof(NODE_HMAP));
+  }
+  if(map->free_nodes != NULL) {
+    p = map->free_nodes;
+    map->free_nodes = p->next;
+    return p;
+  }
+  return arena_alloc(map, 
+	(sizeof(NODE_HMAP) + KEY_ALIGN-1) / KEY_ALIGN * KEY_ALIGN);
+}
+
+// releases all slabs (or all but the newest, which is emptied
+//   for reuse) and forgets the free lists that pointed into them.
+static void free_slabs(HMAP_PTR map, int keep_newest) {
+SLAB *s, *nxt;
+int i;
+
+  s = map->slabs;
+  if(keep_newest && s != NULL) {
+    s->used = 0;
+    s = s->next;
+    map->slabs->next = NULL;
+  }
+  else
+    map->slabs = NULL;
+  for(; s != NULL; s=nxt) {
+    nxt = s->next;
+    map->nbytes -= sizeof(SLAB) + s->cap;
+    free(s);
+  }
+  map->free_nodes = NULL;
+  for(i=0; i<KEY_CLASSES; i++)
+	map->free_keys[i] = NULL;
+}
+
+static void release_node(HMAP_PTR map, NODE_HMAP *p) {
+  if(!map->use_arena) {
+    map->nbytes -= sizeof(NODE_HMAP);
+    free(p);
+    return;
+  }
+  p->next = map->free_nodes;
+  map->free_nodes = p;
+}
+/**** END ALLOCATION UTILITY FUNCTIONS *******/
+
+/**** FLAT ENGINE UTILITY FUNCTIONS *******/
+
+// user hash functions may have weak low/high bits (h0, h1);
+//   scramble them before splitting into group index and tag.
+static unsigned flat_mix(unsigned h) {
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+// bit i of result is set iff g[i] == c
+static unsigned group_match(const signed char *g, signed char c) {
+#ifdef __SSE2__
+  __m128i grp = _mm_loadu_si128((const __m128i *)g);
+  return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(grp, _mm_set1_epi8(c)));
+#else
+unsigned mask = 0;
+int i;
+  for(i=0; i<GROUP_SIZE; i++)
+	if(g[i] == c)
+	   mask |= 1u << i;
+  return mask;
+#endif
+}
+
+// bit i of result is set iff g[i] is empty or deleted
+static unsigned group_free(const signed char *g) {
+#ifdef __SSE2__
+  return (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)g));
+#else
+unsigned mask = 0;
+int i;
+  for(i=0; i<GROUP_SIZE; i++)
+	if(g[i] < 0)
+	   mask |= 1u << i;
+  return mask;
+#endif
+}
+
+// probe sequence visits groups g, g+1, g+3, g+6, ... which
+//   covers every group when the group count is a power of 2.
+static int flat_find(HMAP_PTR map, char *key, unsigned len, unsigned h) {
+unsigned m = flat_mix(h);
+signed char tag = (signed char)(m & 0x7f);
+unsigned gmask = map->tsize/GROUP_SIZE - 1;
+unsigned g = (m >> 7) & gmask;
+unsigned step = 0, bits;
+int i;
+  
+  do {
+    const signed char *grp = map->ctrl + g*GROUP_SIZE;
+
+    bits = group_match(grp, tag);
+    while(bits) {
+	i = g*GROUP_SIZE + __builtin_ctz(bits);
+	if(map->slots[i].hval == h && map->slots[i].klen == len
+		&& memcmp(key, KEY_OF(&map->slots[i]), len)==0)
+	   return i;
+	bits &= bits - 1;
+    }
+    if(group_match(grp, CTRL_EMPTY))
+	return -1;
+    step++;
+    g = (g + step) & gmask;
+  } while(step <= gmask);
+  return -1;
+}
+
+// first empty or deleted slot on the probe sequence for h
+static int flat_find_free(HMAP_PTR map, unsigned h) {
+unsigned m = flat_mix(h);
+unsigned gmask = map->tsize/GROUP_SIZE - 1;
+unsigned g = (m >> 7) & gmask;
+unsigned step = 0, bits;
+
+  for(;;) {
+    bits = group_free(map->ctrl + g*GROUP_SIZE);
+    if(bits)
+	return g*GROUP_SIZE + __builtin_ctz(bits);
+    step++;
+    g = (g + step) & gmask;
+  }
+}
+
+static void flat_alloc(HMAP_PTR map, int tsize) {
+  map->tsize = tsize;
+  map->max_n = (int)(tsize * map->lfactor);
+  map->ndeleted = 0;
+  map->nbytes += tsize * (sizeof(signed char) + sizeof(SLOT_HMAP));
+  map->ctrl = malloc(tsize * sizeof(signed char));
+  memset(map->ctrl, CTRL_EMPTY, tsize);
+  map->slots = malloc(tsize * sizeof(SLOT_HMAP));
+}
+
+// number of groups visited when probing from home group g
+//   until reaching group target (target == -1:  until a group
+//   with an empty slot).
+static int flat_probe_len(HMAP_PTR map, unsigned g, int target) {
+unsigned gmask = map->tsize/GROUP_SIZE - 1;
+unsigned step = 0;
+int len = 1;
+
+  while(step <= gmask) {
+    if(target < 0 ? group_match(map->ctrl + g*GROUP_SIZE, CTRL_EMPTY) != 0
+		  : (int)g == target)
+	return len;
+    step++;
+    g = (g + step) & gmask;
+    len++;
+  }
+  return len;
+}
+
+static void flat_stats(HMAP_PTR map, HMAP_STATS *st) {
+int ngroups = map->tsize/GROUP_SIZE;
+unsigned gmask = ngroups - 1;
+long hit_probes = 0, miss_probes = 0;
+int g, i, c, len;
+
+  for(g=0; g<ngroups; g++) {
+    for(i=g*GROUP_SIZE, c=0; i<(g+1)*GROUP_SIZE; i++) {
+	if(map->ctrl[i] < 0) continue;
+	c++;
+	len = flat_probe_len(map, (flat_mix(map->slots[i].hval) >> 7) & gmask, g);
+	hit_probes += len;
+	if(len > st->max_probe_hit)
+	   st->max_probe_hit = len;
+    }
+    st->chain_hist[c < HMAP_HIST_SIZE ? c : HMAP_HIST_SIZE-1]++;
+    if(c > st->max_chain)
+	st->max_chain = c;
+    len = flat_probe_len(map, g, -1);
+    miss_probes += len;
+    if(len > st->max_probe_miss)
+	st->max_probe_miss = len;
+  }
+  if(map->n > 0)
+    st->mean_probe_hit = (double)hit_probes / map->n;
+  st->mean_probe_miss = (double)miss_probes / ngroups;
+}
+
+// frees the keys (unless arena-owned) and, if requested, the
+//   values of all full slots
+static void flat_free_slots(HMAP_PTR map, int free_vals) {
+int i;
+
+  if(map->use_arena && !free_vals)
+    return;
+  for(i=0; i<map->tsize; i++) {
+    if(map->ctrl[i] < 0) continue;
+    if(!map->use_arena)
+	drop_key(map, &map->slots[i].k, map->slots[i].klen);
+    if(free_vals && map->slots[i].val != NULL)
+	free(map->slots[i].val);
+  }
+}
+
+// rebuild into a table of ntsize slots; drops all tombstones
+static void flat_rehash(HMAP_PTR map, int ntsize) {
+signed char *octrl = map->ctrl;
+SLOT_HMAP *oslots = map->slots;
+int otsize = map->tsize;
+int i, j;
+
+  flat_alloc(map, ntsize);
+  for(i=0; i<otsize; i++) {
+    if(octrl[i] < 0) continue;
+    j = flat_find_free(map, oslots[i].hval);
+    map->ctrl[j] = (signed char)(flat_mix(oslots[i].hval) & 0x7f);
+    map->slots[j] = oslots[i];
+  }
+  free(octrl);
+  free(oslots);
+  map->nbytes -= otsize * (sizeof(signed char) + sizeof(SLOT_HMAP));
+  map->nresizes++;
+  if(map->bloom != NULL)
+    bloom_fit(map);
+}
+
+// key known to be absent; stores a copy of it.
+// \returns the slot index used.
+static int flat_insert(HMAP_PTR map, char *key, unsigned len, void *val, 
+			unsigned h) {
+int i;
+
+  if(map->n + map->ndeleted + 1 > map->max_n) {
+    // mostly tombstones:  clean up in place, else grow
+    if(map->n + 1 <= map->max_n/2)
+	flat_rehash(map, map->tsize);
+    else
+	flat_rehash(map, 2*map->tsize);
+  }
+  i = flat_find_free(map, h);
+  if(map->ctrl[i] == CTRL_DELETED)
+    map->ndeleted--;
+  map->ctrl[i] = (signed char)(flat_mix(h) & 0x7f);
+  store_key(map, &map->slots[i].k, key, len);
+  map->slots[i].klen = len;
+  map->slots[i].val = val;
+  map->slots[i].hval = h;
+  map->n++;
+  if(map->bloom != NULL)
+    bloom_add(map, h);
+  return i;
+}
+/**** END FLAT ENGINE UTILITY FUNCTIONS *******/
+
+/**** BLOOM FILTER UTILITY FUNCTIONS *******/
+
+// stretches the 32 bit hash:  the block index comes from the
+//   high half, the bit positions (see bloom_bits) from the low
+static uint64_t bloom_mix(unsigned h) {
+uint64_t x = h;
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdull;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ull;
+  x ^= x >> 33;
+  return x;
+}
+
+// BLOOM_K 9-bit bit positions, packed:  three from the low half
+//   of x, three from the top of the low half times a constant, so
+//   none shares bits with the block index
+static uint64_t bloom_bits(uint64_t x) {
+uint64_t lo = x & 0xffffffffull;
+  return (lo & 0x7ffffff) | ((lo * 0x9e3779b97f4a7c15ull) >> 37 << 27);
+}
+
+static void bloom_add(HMAP_PTR map, unsigned h) {
+uint64_t x = bloom_mix(h);
+uint64_t *blk = map->bloom + ((x >> 32) & map->bloom_mask)*BLOOM_BLOCK_WORDS;
+uint64_t bits = bloom_bits(x);
+int i, bit;
+
+  for(i=0; i<BLOOM_K; i++) {
+    bit = (int)((bits >> (i*9)) & 511);   // 512 bits per block
+    blk[bit >> 6] |= 1ull << (bit & 63);
+  }
+}
+
+// 0:  h definitely not in the filter; 1:  maybe
+static int bloom_test(uint64_t *bloom, unsigned mask, unsigned h) {
+uint64_t x = bloom_mix(h);
+uint64_t *blk = bloom + ((x >> 32) & mask)*BLOOM_BLOCK_WORDS;
+uint64_t bits = bloom_bits(x);
+int i, bit;
+
+  for(i=0; i<BLOOM_K; i++) {
+    bit = (int)((bits >> (i*9)) & 511);
+    if(!(blk[bit >> 6] & (1ull << (bit & 63))))
+	return 0;
+  }
+  return 1;
+}
+
+// 0:  h definitely not present; 1:  maybe present.  During an
+//   incremental migration a key in an unmigrated old bucket may
+//   only be in the old filter.
+static int bloom_maybe(HMAP_PTR map, unsigned h) {
+  if(bloom_test(map->bloom, map->bloom_mask, h))
+    return 1;
+  return map->old_bloom != NULL && (int)(h % map->old_tsize) >= map->migrate_pos
+	&& bloom_test(map->old_bloom, map->old_bloom_mask, h);
+}
+
+// blocks needed for BLOOM_BITS bits per key at max_n keys
+static unsigned bloom_nblocks(HMAP_PTR map) {
+unsigned nblocks = 1;
+size_t nbits = (size_t)(map->max_n + 1) * BLOOM_BITS;
+
+  while((size_t)nblocks * BLOOM_BLOCK_WORDS * 64 < nbits)
+    nblocks *= 2;
+  return nblocks;
+}
+
+// replaces the filter with an empty one of nblocks blocks; calloc
+//   (aligned by hand) hands back zeroed pages without a memset
+static void bloom_alloc(HMAP_PTR map, unsigned nblocks) {
+size_t bytes = (size_t)nblocks * BLOOM_BLOCK_WORDS * sizeof(uint64_t);
+
+  if(map->bloom != NULL)
+    map->nbytes -= (map->bloom_mask + 1) * BLOOM_BLOCK_WORDS * sizeof(uint64_t);
+  free(map->bloom_base);
+  map->bloom_base = calloc(1, bytes + 63);
+  map->bloom = (uint64_t *)(((uintptr_t)map->bloom_base + 63) & ~(uintptr_t)63);
+  map->bloom_mask = nblocks - 1;
+  map->nbytes += bytes;
+}
+
+// (re)sizes the filter for the current max_n and rebuilds it
+//   from the keys present
+static void bloom_fit(HMAP_PTR map) {
+unsigned nblocks = bloom_nblocks(map);
+NODE_HMAP *p;
+int i;
+
+  if(map->bloom == NULL || nblocks != map->bloom_mask + 1)
+    bloom_alloc(map, nblocks);
+  else
+    memset(map->bloom, 0, (size_t)nblocks * BLOOM_BLOCK_WORDS * sizeof(uint64_t));
+  map->bloom_stale = 0;
+
+  if(map->engine == HMAP_FLAT) {
+    for(i=0; i<map->tsize; i++)
+	if(map->ctrl[i] >= 0)
+	   bloom_add(map, map->slots[i].hval);
+    return;
+  }
+  for(i=0; i<map->tsize; i++)
+    for(p=map->tbl[i].members; p != NULL; p=p->next)
+	bloom_add(map, p->hval);
+  if(map->old_tbl != NULL) {  // only unmigrated old buckets hold nodes
+    for(i=map->migrate_pos; i<map->old_tsize; i++)
+	for(p=map->old_tbl[i].members; p != NULL; p=p->next)
+	   bloom_add(map, p->hval);
+    if(map->old_bloom != NULL)  // the new filter now covers every key
+	drop_old_bloom(map);
+  }
+}
+
+static void drop_old_bloom(HMAP_PTR map) {
+  map->nbytes -= (map->old_bloom_mask + 1) * BLOOM_BLOCK_WORDS * sizeof(uint64_t);
+  free(map->old_bloom_base);
+  map->old_bloom = NULL;
+}
+
+static void bloom_removed(HMAP_PTR map) {
+  if(++map->bloom_stale > map->n/4 + BLOOM_MIN_STALE)
+    bloom_fit(map);
+}
+/**** END BLOOM FILTER UTILITY FUNCTIONS *******/
+
+/**** FROZEN INDEX UTILITY FUNCTIONS *******/
+
+static int frozen_bucket(HMAP_FROZEN_PTR fm, uint64_t h) {
+uint64_t x = h >> 32;
+
+  if(x < FROZEN_DENSE_KEYS)
+    return (int)(x * fm->ndense / FROZEN_DENSE_KEYS);
+  return fm->ndense + (int)((x - FROZEN_DENSE_KEYS) * (fm->nbuckets - fm->ndense)
+			/ ((1ull << 32) - FROZEN_DENSE_KEYS));
+}
+
+// position in [0, m) for hash h under pilot; see frozen_find.
+//   With m a power of two, keys agreeing in their low bits would
+//   collide under every pilot, hence m is odd.
+static int frozen_slot(HMAP_FROZEN_PTR fm, uint64_t h, uint32_t pilot) {
+  return (int)((h ^ mum(pilot + 1, 0xe7037ed1a0b428dbull)) % fm->m);
+}
+
+// slot index of key, or -1:  one hash, one slot, one compare
+static int frozen_find(HMAP_FROZEN_PTR fm, char *key) {
+size_t len = strlen(key);
+uint64_t h;
+int i;
+
+  if(fm->n == 0)
+    return -1;
+  h = wymix64(key, len, fm->seed);
+  i = frozen_slot(fm, h, fm->pilots[frozen_bucket(fm, h)]);
+  if(i >= fm->n)
+    i = fm->remap[i - fm->n];
+  if(fm->key_off[i+1] - fm->key_off[i] != len 
+	|| memcmp(fm->blob + fm->key_off[i], key, len) != 0)
+    return -1;
+  return i;
+}
+
+/*
+* PTHash-style search:  buckets are placed largest first and 
+*   each gets the smallest pilot that sends all its keys to 
+*   distinct free slots.
+*   Positions run over m > n slots; afterwards keys placed at
+*   positions >= n are moved to the free slots below n and
+*   fm->remap records where.
+* \returns 1 and fills slot_of[] (key index -> slot) on 
+*   success; 0 if the current seed does not work.
+*/
+#define TAKEN(bits, s) ((bits)[(s) >> 6] >> ((s) & 63) & 1)
+
+static int frozen_build(HMAP_FROZEN_PTR fm, char **keys, unsigned *lens,
+			int *slot_of) {
+int n = fm->n, m = fm->m, nb = fm->nbuckets;
+uint64_t *h = malloc((n + 1) * sizeof(uint64_t));
+int *bstart = calloc(nb + 2, sizeof(int));    // keys grouped by bucket
+int *bkeys = malloc((n + 1) * sizeof(int));
+uint64_t *bh;                                  // hashes in bkeys order
+int *bslot = malloc((n + 1) * sizeof(int));    // slots in bkeys order
+int *order = malloc((nb + 1) * sizeof(int));   // buckets by size desc
+int *size_cnt = calloc(n + 2, sizeof(int));
+uint64_t *taken = calloc(m/64 + 1, sizeof(uint64_t));   // bit per slot:  stays in cache
+int i, j, b, sz, ok = 1;
+uint32_t pilot;
+
+  for(i=0; i<n; i++) {
+    h[i] = wymix64(keys[i], lens[i], fm->seed);
+    bstart[frozen_bucket(fm, h[i]) + 2]++;
+  }
+  for(b=0; b<nb; b++)   // counting sort keys by bucket
+    bstart[b+2] += bstart[b+1];
+  for(i=0; i<n; i++)
+    bkeys[bstart[frozen_bucket(fm, h[i]) + 1]++] = i;
+  // now bucket b holds bkeys[bstart[b] .. bstart[b+1]); copy the
+  //   hashes into that order so a bucket's probes read one run
+  bh = malloc((n + 1) * sizeof(uint64_t));
+  for(i=0; i<n; i++)
+    bh[i] = h[bkeys[i]];
+  free(h);
+
+  for(b=0; b<nb; b++)   // counting sort buckets by size
+    size_cnt[bstart[b+1] - bstart[b]]++;
+  for(sz=n, j=0; sz>=0; sz--) {
+    int c = size_cnt[sz];
+    size_cnt[sz] = j;
+    j += c;
+  }
+  for(b=0; b<nb; b++)
+    order[size_cnt[bstart[b+1] - bstart[b]]++] = b;
+
+  for(j=0; j<nb && ok; j++) {
+    int lo, hi;
+
+    b = order[j];
+    lo = bstart[b];
+    hi = bstart[b+1];
+    if(lo == hi) {
+	fm->pilots[b] = 0;
+	continue;
+    }
+    for(pilot=0; ; pilot++) {
+	if(pilot > FROZEN_MAX_PILOT) {
+	   ok = 0;
+	   break;
+	}
+	for(i=lo; i<hi; i++) {
+	   int s = frozen_slot(fm, bh[i], pilot);
+	   if(TAKEN(taken, s))
+		break;
+	   taken[s >> 6] |= 1ull << (s & 63);
+	   bslot[i] = s;
+	}
+	if(i == hi)
+	   break;
+	while(--i >= lo)   // undo partial placement
+	   taken[bslot[i] >> 6] &= ~(1ull << (bslot[i] & 63));
+    }
+    fm->pilots[b] = pilot;
+  }
+
+  // as many slots below n are free as keys sit at or above n:
+  //   pair them up in order
+  if(ok) {
+    for(i=n, j=0; i<m; i++) {
+	if(!TAKEN(taken, i)) {
+	   fm->remap[i - n] = 0;   // only absent keys land here
+	   continue;
+	}
+	while(TAKEN(taken, j))
+	   j++;
+	fm->remap[i - n] = j++;
+    }
+    for(i=0; i<n; i++)
+	slot_of[bkeys[i]] = bslot[i] < n ? bslot[i] : (int)fm->remap[bslot[i] - n];
+  }
+  free(bh);
+  free(bslot);
+  free(bstart);
+  free(bkeys);
+  free(order);
+  free(size_cnt);
+  free(taken);
+  return ok;
+}
+/**** END FROZEN INDEX UTILITY FUNCTIONS *******/
+
 
 
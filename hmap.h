@@ -1,18 +1,95 @@
 
+#include <stddef.h>
+
 typedef unsigned (*HFUNC)(char *);
 
 typedef struct hmap *HMAP_PTR;
 
+typedef struct hmap_frozen *HMAP_FROZEN_PTR;
+
 
 #define NAIVE_HFUNC 0
 #define BASIC_WEIGHTED_HFUNC 1
 
+/* FNV-1a with a 64 bit state, folded to 32 bits */
+#define FNV1A_HFUNC 2
+/* 8-bytes-at-a-time multiply/fold mixer (wyhash family) */
+#define WYMIX_HFUNC 3
+/* CRC32C; uses the SSE4.2 crc32 instruction when the cpu 
+*    has it, a table-driven loop otherwise.
+*/
+#define CRC32C_HFUNC 4
+
 #define DEFAULT_HFUNC_ID BASIC_WEIGHTED_HFUNC
 
 #define DEFAULT_INIT_SIZE 128
 
 #define DEFAULT_LFACTOR (0.75)
 
+#define HMAP_HIST_SIZE 16
+
+/**
+* storage engine flags for hmap_create_ex.
+*
+* HMAP_CHAINED (the default) keeps a linked list of nodes
+*   per table entry.
+* HMAP_FLAT uses a single power-of-two open-addressed slot
+*   array with one control byte per slot (7 bits of hash or
+*   an empty/deleted marker).  Control bytes are scanned 16
+*   at a time (SSE2 when available), so a lookup usually
+*   touches one control group and one slot.
+*/
+#define HMAP_CHAINED 0
+#define HMAP_FLAT 1
+
+/**
+* may be or-ed with either engine flag.
+*
+* HMAP_ARENA carves nodes and cloned keys out of large slabs
+*   owned by the map instead of calling malloc/free per key.
+*   Nodes and key buffers released by hmap_remove are kept
+*   on free lists and reused by later inserts; all slabs are
+*   returned in one shot by hmap_free.
+*/
+#define HMAP_ARENA 2
+
+/**
+* HMAP_INCREMENTAL (chained engine only; ignored by HMAP_FLAT)
+*   spreads each table doubling over later operations instead
+*   of relinking every node inside one hmap_set.  While a 
+*   migration is in progress the old and new tables coexist;
+*   every hmap_set/get/contains/remove first moves up to 
+*   HMAP_MIGRATE_STEP old buckets (more at load factors below
+*   1/HMAP_MIGRATE_STEP, so a migration always ends before the
+*   next doubling) into the new table and lookups consult
+*   whichever table owns the key's bucket.
+*/
+#define HMAP_INCREMENTAL 4
+#define HMAP_MIGRATE_STEP 4
+
+/**
+* HMAP_BLOOM keeps a blocked Bloom filter of the stored hash
+*   values next to the table.  hmap_get, hmap_contains,
+*   hmap_remove and hmap_get_batch reject most absent keys
+*   after probing a single cache line of the filter, without 
+*   touching the table.  The filter is updated by every insert 
+*   and rebuilt when the table is resized, cleared, or after 
+*   enough removals have made it stale (rebuilds are O(n)).
+*   With HMAP_INCREMENTAL a resize instead starts an empty 
+*   filter that keys enter as their buckets migrate.
+*
+*   Keys whose hash values collide are indistinguishable to
+*   the filter, so it helps little with weak hash functions
+*   such as NAIVE_HFUNC.
+*/
+#define HMAP_BLOOM 8
+
+/**
+* open addressing cannot exceed a load factor of 1; the flat
+*   engine clamps the requested load factor to this value.
+*/
+#define HMAP_FLAT_MAX_LFACTOR (0.875)
+
 /**
 * Creates and initializes a hash map data structure with
 *   given initial table size and specified load factor.
@@ -29,6 +106,17 @@ typedef struct hmap *HMAP_PTR;
 */
 extern HMAP_PTR hmap_create(unsigned init_tsize, double lfactor);
 
+/**
+* same as hmap_create but also selects the storage engine.
+*
+* \param flags is HMAP_CHAINED or HMAP_FLAT, optionally 
+*   or-ed with HMAP_ARENA, HMAP_INCREMENTAL and/or HMAP_BLOOM.
+*   For HMAP_FLAT, init_tsize is rounded up to a power of
+*   two (at least 16).
+*/
+extern HMAP_PTR hmap_create_ex(unsigned init_tsize, double lfactor, 
+				int flags);
+
 /**
 * \returns number of distinct keys in the map
 */
@@ -45,11 +133,30 @@ extern void hmap_display(HMAP_PTR map);
 * sets hash function as specified by hfunc_id to one
 *   of the pre-defined hash functions.
 * if table not empty, operation fails and returns 0.
-* See #defines for NAIVE_HFUNC and BASIC_WEIGHTED_HFUNC 
-*   for example
+* See #defines for NAIVE_HFUNC, BASIC_WEIGHTED_HFUNC,
+*   FNV1A_HFUNC, WYMIX_HFUNC and CRC32C_HFUNC.
 */
 extern int hmap_set_hfunc(HMAP_PTR map, int hfunc_id); 
 
+/**
+* measures how evenly the current keys are spread over the
+*   table entries by the map's hash function, comparing the 
+*   expected number of key comparisons for a successful 
+*   search with that of a uniformly random hash function.
+*
+* \returns 1.0 for an ideal distribution; larger values are
+*   worse (e.g., 2.0 means chains twice as costly as ideal).
+*   Returns 0.0 for an empty map.
+*/
+extern double hmap_hfunc_quality(HMAP_PTR map);
+
+/**
+* \returns the built-in hash function with the given id
+*   (see hmap_set_hfunc) or NULL if the id is invalid.
+*   Lets other containers share the hmap hash functions.
+*/
+extern HFUNC hmap_builtin_hfunc(int hfunc_id);
+
 /**
 * sets hash function to user-specified hfunc if table 
 *    empty (and returns 1).
@@ -81,6 +188,21 @@ extern int hmap_contains(HMAP_PTR map, char *key);
 */
 extern void *hmap_get(HMAP_PTR map, char *key);
 
+/**
+* looks up nkeys keys at once; vals[i] receives the value
+*   associated with keys[i] (NULL if absent, with the same
+*   caveat as hmap_get).
+*
+* Keys are processed in small windows:  all keys in a window
+*   are hashed first and their buckets, nodes and stored keys
+*   are prefetched in stages, so the cache misses of different
+*   keys overlap instead of being paid one after another.
+*
+* \returns number of keys found.
+*/
+extern int hmap_get_batch(HMAP_PTR map, char **keys, int nkeys, 
+				void **vals);
+
 /**
 * sets the value associated with key to the given value
 *   (val).
@@ -93,6 +215,44 @@ extern void *hmap_get(HMAP_PTR map, char *key);
 extern void * hmap_set(HMAP_PTR map, char *key, void *val);
 
 
+/**
+* upsert:  finds or creates the entry for key and returns
+*   a pointer to its value slot so the caller can read and
+*   write the value without a second lookup.  A newly 
+*   created entry has value NULL.
+*
+* If inserted is non-NULL, *inserted is set to 1 if the key 
+*   was added and 0 if it was already present.
+*
+* The returned pointer is only valid until the next call
+*   that inserts or removes keys.
+*/
+extern void **hmap_upsert(HMAP_PTR map, char *key, int *inserted);
+
+/**
+* hash-once variants.
+*
+* hmap_hash returns the hash the map's hash function gives 
+*   key.  The *_h functions below behave like their plain
+*   counterparts but take the key's length (as strlen would
+*   report it) and its hash from the caller, so a key that 
+*   is used for several operations is hashed and scanned only
+*   once.  Keys are compared by length and memcmp; key need
+*   not be nul-terminated at key[len].
+*
+* Passing an hval that is not hmap_hash of the key gives
+*   undefined results.
+*/
+extern unsigned hmap_hash(HMAP_PTR map, char *key);
+extern int hmap_contains_h(HMAP_PTR map, char *key, unsigned len, 
+				unsigned hval);
+extern void *hmap_get_h(HMAP_PTR map, char *key, unsigned len, 
+				unsigned hval);
+extern void *hmap_set_h(HMAP_PTR map, char *key, unsigned len, 
+				unsigned hval, void *val);
+extern void **hmap_upsert_h(HMAP_PTR map, char *key, unsigned len, 
+				unsigned hval, int *inserted);
+
 /**
 * Removes entry corresponding to given key (if any).
 * \returns previously associated value (if key not
@@ -102,12 +262,63 @@ extern void *hmap_remove(HMAP_PTR map, char *key);
 
 
 /**
-* Prints statistical information about the map.
+* statistics snapshot filled in by hmap_get_stats.
 *
-* currently unimplemented
+* For the chained engine a "probe" is one key comparison and
+*   a "chain" is the list hanging off one table entry.
+* For the flat engine a "probe" is one 16-slot control group
+*   visited and a "chain" is the set of keys in one group.
+*
+* probes for a miss are averaged over all possible home 
+*   positions (i.e., assuming uniformly hashed absent keys).
+*/
+typedef struct {
+    char *engine;          // "chained" or "flat"
+    char *hfunc_desc;
+    int n;                 // number of keys
+    int tsize;             // table entries (slots for flat)
+    double load_factor;    // n / tsize
+    int chain_hist[HMAP_HIST_SIZE];  // chains with i keys;
+                                     //   last bin counts >= i
+    int max_chain;
+    double mean_probe_hit;
+    int max_probe_hit;
+    double mean_probe_miss;
+    int max_probe_miss;
+    int nresizes;          // table rebuilds so far
+    size_t bytes_allocated;// currently held by the map
+    double hfunc_quality;  // see hmap_hfunc_quality
+} HMAP_STATS;
+
+/**
+* fills *stats with a snapshot of the map's statistics.
+*
+* Runtime:  O(tsize + n)
+*/
+extern void hmap_get_stats(HMAP_PTR map, HMAP_STATS *stats);
+
+/**
+* Prints statistical information about the map
+*   (see HMAP_STATS) to stdout.
 */
 extern void hmap_print_stats(HMAP_PTR map); 
 
+/**
+* Removes all entries but keeps the table (and, in arena mode,
+*   one slab) so the map can be refilled without allocating
+*   from scratch.  free_vals_flag as in hmap_free.
+*
+* Runtime:  O(tsize + n), no recursion
+*/
+extern void hmap_clear(HMAP_PTR map, int free_vals_flag);
+
+/**
+* Grows the table (if needed) so that n keys fit without any
+*   further resize; bulk loads should call this first.
+*   Never shrinks the table.
+*/
+extern void hmap_reserve(HMAP_PTR map, int n);
+
 /**
 * Deallocates all memory internally allocated for the map
 *
@@ -123,5 +334,40 @@ extern void hmap_print_stats(HMAP_PTR map);
 */
 extern void hmap_free(HMAP_PTR map, int free_vals_flag); 
 
+/**
+* Builds an immutable index over the current contents of map
+*   for maps that are no longer modified after loading.
+*
+* The index is a minimal perfect hash (PTHash/CHD style):  
+*   keys are packed back to back in one blob in slot order
+*   and a lookup costs one hash, one pilot read, one slot read
+*   and one compare.  Besides the key bytes, the index uses
+*   about 8 bits of pilot per key (plus a 32 bit remap entry
+*   for about 1% of keys), a 32 bit offset and the
+*   value pointer per key.
+*
+* The map is not modified and may be freed afterwards (with
+*   free_vals_flag false, since the index shares the values).
+*
+* \returns the index, or NULL in the (practically impossible)
+*   case that no hash seed tried yields one.
+*
+* Runtime:  expected O(n) to build
+*/
+extern HMAP_FROZEN_PTR hmap_freeze(HMAP_PTR map);
+
+/**
+* lookups on a frozen index; same semantics as hmap_size,
+*   hmap_contains and hmap_get.
+*/
+extern int hmap_frozen_size(HMAP_FROZEN_PTR fm);
+extern int hmap_frozen_contains(HMAP_FROZEN_PTR fm, char *key);
+extern void *hmap_frozen_get(HMAP_FROZEN_PTR fm, char *key);
+
+/**
+* Deallocates the index (values are never freed).
+*/
+extern void hmap_frozen_free(HMAP_FROZEN_PTR fm);
+
 
 
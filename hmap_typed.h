@@ -0,0 +1,261 @@
+#ifndef HMAP_TYPED_H
+#define HMAP_TYPED_H
+
+/**
+* General description:  macro-generated, type-specialized hash
+*   maps for keys and values that are not (char *, void *).
+*
+*   HMAP_TYPED_DECLARE expands to an open-addressed (linear
+*   probing, power-of-two) map whose keys and values are stored
+*   inline in parallel arrays.  Hash, equality, key copy and
+*   key release are macros or inline functions named at
+*   expansion time, so the compiler sees every call -- there
+*   are no per-value heap objects and no calls through function
+*   pointers.  Removal uses backward shifting, so there are no
+*   tombstones.
+*
+*   Expanding
+*
+*     HMAP_TYPED_DECLARE(pfx, PTR, KTYPE, VTYPE, HASH, EQ, KDUP, KFREE)
+*
+*   defines the handle type PTR and these static functions:
+*
+*     PTR pfx_create(int init_tsize);    // 0:  default size
+*     int pfx_size(PTR map);
+*     int pfx_contains(PTR map, KTYPE key);
+*     VTYPE *pfx_find(PTR map, KTYPE key);   // NULL if absent
+*     int pfx_get(PTR map, KTYPE key, VTYPE *val);  // 0/1
+*     VTYPE *pfx_upsert(PTR map, KTYPE key, int *inserted);
+*     int pfx_set(PTR map, KTYPE key, VTYPE val);   // 1 if new
+*     int pfx_remove(PTR map, KTYPE key, VTYPE *val); // 0/1
+*     void pfx_free(PTR map);
+*
+*   HASH(k) must return an unsigned; EQ(a, b) nonzero iff the
+*   keys are equal; KDUP(k) returns the copy the map keeps;
+*   KFREE(k) releases such a copy.
+*
+*   Pointers returned by pfx_find/pfx_upsert are valid until
+*   the next insert or remove.
+*
+*   Two instantiations are predefined:
+*     str_i32_map_*  (STR_I32_MAP_PTR):  char * -> int32_t, keys
+*                                        are copied
+*     u64_ptr_map_*  (U64_PTR_MAP_PTR):  uint64_t -> void *
+**/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HMAP_TYPED_INIT_SIZE 16
+
+/* ... as a fraction:  grow when n+1 > tsize * 3/4 */
+#define HMAP_TYPED_LF_NUM 3
+#define HMAP_TYPED_LF_DEN 4
+
+
+/******** KEY HELPERS FOR THE PREDEFINED MAPS *********/
+
+// FNV-1a with a 64 bit state, folded to 32 bits
+static inline unsigned hmap_typed_str_hash(const char *s) {
+uint64_t h = 0xcbf29ce484222325ull;
+
+  while(*s != '\0') {
+	h ^= (unsigned char)*s;
+	h *= 0x100000001b3ull;
+	s++;
+  }
+  return (unsigned)(h ^ (h >> 32));
+}
+
+static inline char *hmap_typed_str_dup(const char *s) {
+size_t len = strlen(s) + 1;
+char *c = malloc(len);
+  memcpy(c, s, len);
+  return c;
+}
+
+// murmur3 finalizer
+static inline unsigned hmap_typed_u64_hash(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdull;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ull;
+  k ^= k >> 33;
+  return (unsigned)k;
+}
+
+#define HMAP_TYPED_STR_EQ(a, b) (strcmp((a), (b)) == 0)
+#define HMAP_TYPED_STR_FREE(k) free(k)
+#define HMAP_TYPED_VAL_EQ(a, b) ((a) == (b))
+#define HMAP_TYPED_NO_DUP(k) (k)
+#define HMAP_TYPED_NO_FREE(k) ((void)(k))
+
+/******** END KEY HELPERS *********/
+
+
+/*
+* hashes[i] is 0 for an empty slot, else the key's hash forced
+*   non-zero; it doubles as a cheap filter before EQ.
+*/
+#define HMAP_TYPED_DECLARE(PFX, PTR, KTYPE, VTYPE, HASH, EQ, KDUP, KFREE) \
+									\
+typedef struct PFX##_struct {						\
+    unsigned *hashes;							\
+    KTYPE *keys;							\
+    VTYPE *vals;							\
+    int tsize;								\
+    int n;								\
+} *PTR;									\
+									\
+static inline unsigned PFX##_hash(KTYPE key) {				\
+unsigned h = HASH(key);							\
+  return h ? h : 1;							\
+}									\
+									\
+static inline void PFX##_alloc(PTR map, int tsize) {			\
+  map->tsize = tsize;							\
+  map->hashes = calloc(tsize, sizeof(unsigned));			\
+  map->keys = malloc(tsize * sizeof(KTYPE));				\
+  map->vals = malloc(tsize * sizeof(VTYPE));				\
+}									\
+									\
+static inline PTR PFX##_create(int init_tsize) {			\
+PTR map = malloc(sizeof(struct PFX##_struct));				\
+int tsize = HMAP_TYPED_INIT_SIZE;					\
+									\
+  while(tsize < init_tsize)						\
+	tsize *= 2;							\
+  PFX##_alloc(map, tsize);						\
+  map->n = 0;								\
+  return map;								\
+}									\
+									\
+static inline int PFX##_size(PTR map) {					\
+  return map->n;							\
+}									\
+									\
+/* slot holding key, or -1 */						\
+static inline int PFX##_slot(PTR map, KTYPE key, unsigned h) {		\
+unsigned mask = map->tsize - 1, i = h & mask;				\
+									\
+  while(map->hashes[i] != 0) {						\
+	if(map->hashes[i] == h && EQ(map->keys[i], key))		\
+	   return (int)i;						\
+	i = (i + 1) & mask;						\
+  }									\
+  return -1;								\
+}									\
+									\
+static inline int PFX##_contains(PTR map, KTYPE key) {			\
+  return PFX##_slot(map, key, PFX##_hash(key)) >= 0;			\
+}									\
+									\
+static inline VTYPE *PFX##_find(PTR map, KTYPE key) {			\
+int i = PFX##_slot(map, key, PFX##_hash(key));				\
+  return (i < 0 ? NULL : &map->vals[i]);				\
+}									\
+									\
+static inline int PFX##_get(PTR map, KTYPE key, VTYPE *val) {		\
+int i = PFX##_slot(map, key, PFX##_hash(key));				\
+  if(i < 0)								\
+	return 0;							\
+  *val = map->vals[i];							\
+  return 1;								\
+}									\
+									\
+static inline void PFX##_grow(PTR map) {				\
+unsigned *ohashes = map->hashes;					\
+KTYPE *okeys = map->keys;						\
+VTYPE *ovals = map->vals;						\
+int otsize = map->tsize, i;						\
+unsigned j, mask;							\
+									\
+  PFX##_alloc(map, 2*otsize);						\
+  mask = map->tsize - 1;						\
+  for(i=0; i<otsize; i++) {						\
+	if(ohashes[i] == 0) continue;					\
+	for(j=ohashes[i] & mask; map->hashes[j] != 0; j=(j+1) & mask)	\
+	   ;								\
+	map->hashes[j] = ohashes[i];					\
+	map->keys[j] = okeys[i];					\
+	map->vals[j] = ovals[i];					\
+  }									\
+  free(ohashes);							\
+  free(okeys);								\
+  free(ovals);								\
+}									\
+									\
+/* a new key's value is left uninitialized for the caller */		\
+static inline VTYPE *PFX##_upsert(PTR map, KTYPE key, int *inserted) {	\
+unsigned h = PFX##_hash(key), mask, i;					\
+int s = PFX##_slot(map, key, h);					\
+									\
+  if(s >= 0) {								\
+	if(inserted != NULL)						\
+	   *inserted = 0;						\
+	return &map->vals[s];						\
+  }									\
+  if((map->n + 1) * HMAP_TYPED_LF_DEN > map->tsize * HMAP_TYPED_LF_NUM)	\
+	PFX##_grow(map);						\
+  mask = map->tsize - 1;						\
+  for(i=h & mask; map->hashes[i] != 0; i=(i+1) & mask)			\
+	;								\
+  map->hashes[i] = h;							\
+  map->keys[i] = KDUP(key);						\
+  map->n++;								\
+  if(inserted != NULL)							\
+	*inserted = 1;							\
+  return &map->vals[i];							\
+}									\
+									\
+static inline int PFX##_set(PTR map, KTYPE key, VTYPE val) {		\
+int inserted;								\
+  *PFX##_upsert(map, key, &inserted) = val;				\
+  return inserted;							\
+}									\
+									\
+static inline int PFX##_remove(PTR map, KTYPE key, VTYPE *val) {	\
+unsigned mask = map->tsize - 1, i, j, home;				\
+int s = PFX##_slot(map, key, PFX##_hash(key));				\
+									\
+  if(s < 0)								\
+	return 0;							\
+  if(val != NULL)							\
+	*val = map->vals[s];						\
+  KFREE(map->keys[s]);							\
+  /* shift later members of the cluster back into the hole */	\
+  for(i=(unsigned)s, j=(i+1) & mask; map->hashes[j] != 0; j=(j+1) & mask) { \
+	home = map->hashes[j] & mask;					\
+	if(((j - home) & mask) >= ((j - i) & mask)) {			\
+	   map->hashes[i] = map->hashes[j];				\
+	   map->keys[i] = map->keys[j];					\
+	   map->vals[i] = map->vals[j];					\
+	   i = j;							\
+	}								\
+  }									\
+  map->hashes[i] = 0;							\
+  map->n--;								\
+  return 1;								\
+}									\
+									\
+static inline void PFX##_free(PTR map) {				\
+int i;									\
+  for(i=0; i<map->tsize; i++)						\
+	if(map->hashes[i] != 0)						\
+	   KFREE(map->keys[i]);						\
+  free(map->hashes);							\
+  free(map->keys);							\
+  free(map->vals);							\
+  free(map);								\
+}
+
+HMAP_TYPED_DECLARE(str_i32_map, STR_I32_MAP_PTR, char *, int32_t,
+	hmap_typed_str_hash, HMAP_TYPED_STR_EQ, hmap_typed_str_dup,
+	HMAP_TYPED_STR_FREE)
+
+HMAP_TYPED_DECLARE(u64_ptr_map, U64_PTR_MAP_PTR, uint64_t, void *,
+	hmap_typed_u64_hash, HMAP_TYPED_VAL_EQ, HMAP_TYPED_NO_DUP,
+	HMAP_TYPED_NO_FREE)
+
+#endif
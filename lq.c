@@ -0,0 +1,139 @@
+#include "lq.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_LINE 64
+#define ARITY 4
+#define MIN_CAPACITY 16
+
+/*
+* entries of a 4-ary heap (root at 0, children of i at 4i+1 ..
+*   4i+4).  An entry is 16 bytes, so the heap is shifted by
+*   ARITY-1 slots from a cache-line aligned base and the four
+*   children of a node fill exactly one line.
+*/
+typedef struct {
+	double priority;
+	int id;
+} ENTRY;
+
+struct lq_struct {
+	ENTRY* heap;
+	ENTRY* heap_base;	// allocation behind heap
+	int size;
+	int capacity;
+};
+
+static ENTRY* alloc_heap(int capacity);
+
+LQ* lq_create(int capacity) {
+	LQ* lq = malloc(sizeof(LQ));
+
+	if(capacity < MIN_CAPACITY)
+		capacity = MIN_CAPACITY;
+	lq->heap_base = alloc_heap(capacity);
+	lq->heap = lq->heap_base + ARITY-1;
+	lq->size = 0;
+	lq->capacity = capacity;
+
+	return lq;
+}
+
+void lq_free(LQ* lq) {
+	if(lq == NULL)
+		return;
+	free(lq->heap_base);
+	free(lq);
+}
+
+int lq_push(LQ* lq, int id, double priority) {
+	int index, parent_index;
+
+	if(lq->size == lq->capacity) {
+		ENTRY* base = alloc_heap(2*lq->capacity);	// realloc would lose the alignment
+		if(base == NULL) {
+			printf("Out of memory.\n");
+			return 0;
+		}
+		memcpy(base + ARITY-1, lq->heap, sizeof(ENTRY)*lq->size);
+		free(lq->heap_base);
+		lq->heap_base = base;
+		lq->heap = base + ARITY-1;
+		lq->capacity *= 2;
+	}
+
+	// sift a hole up from the end
+	index = lq->size++;
+	while(index > 0) {
+		parent_index = (index-1)/ARITY;
+		if(lq->heap[parent_index].priority <= priority)
+			break;
+		lq->heap[index] = lq->heap[parent_index];
+		index = parent_index;
+	}
+	lq->heap[index].priority = priority;
+	lq->heap[index].id = id;
+
+	return 1;
+}
+
+int lq_pop(LQ* lq, int *id, double *priority) {
+	int index = 0, first, last, child, best;
+	ENTRY moving;
+
+	if(lq->size == 0)
+		return 0;
+
+	*id = lq->heap[0].id;
+	*priority = lq->heap[0].priority;
+
+	// sift a hole down from the root for the last entry
+	moving = lq->heap[--lq->size];
+	first = 1;
+	while(first < lq->size) {
+		best = first;
+		last = first + ARITY;
+		if(last > lq->size)
+			last = lq->size;
+		for(child = first+1; child < last; child++)
+			if(lq->heap[child].priority < lq->heap[best].priority)
+				best = child;
+		if(lq->heap[best].priority >= moving.priority)
+			break;
+		lq->heap[index] = lq->heap[best];
+		index = best;
+		first = ARITY*index + 1;
+	}
+	lq->heap[index] = moving;
+
+	return 1;
+}
+
+int lq_top(LQ* lq, int *id, double *priority) {
+	if(lq->size == 0)
+		return 0;
+
+	*id = lq->heap[0].id;
+	*priority = lq->heap[0].priority;
+
+	return 1;
+}
+
+int lq_size(LQ* lq) {
+	return lq->size;
+}
+
+void lq_reset(LQ* lq) {
+	lq->size = 0;
+}
+
+/**** UTILITY FUNCTIONS *******/
+
+static ENTRY* alloc_heap(int capacity) {
+	size_t bytes = sizeof(ENTRY)*(capacity+ARITY-1);
+
+	bytes = (bytes + CACHE_LINE-1) / CACHE_LINE * CACHE_LINE;	// aligned_alloc wants a multiple
+	return aligned_alloc(CACHE_LINE, bytes);
+}
+/**** END UTILITY FUNCTIONS *******/
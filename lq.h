@@ -0,0 +1,75 @@
+/**
+* General description:  insert-only min-queue of <id, priority>
+*   pairs for "lazy deletion" searches.
+*
+*   Unlike pq there is no id -> position map:  the same id may
+*   be pushed any number of times and nothing can be looked up,
+*   changed or removed by id.  To lower an id's priority, push it
+*   again; when the older, now stale, entries reach the top the
+*   caller recognizes and skips them (in Dijkstra's algorithm:  an
+*   entry whose priority is above the vertex's current distance).
+*
+*   Memory is proportional to the number of entries pushed since
+*   the last reset, not to the range of ids, and the array grows
+*   as needed.  Entries live in a 4-ary heap whose children of a
+*   node share one cache line.
+**/
+
+// "Opaque type" -- definition of lq_struct hidden in lq.c
+typedef struct lq_struct LQ;
+
+/**
+* Function: lq_create
+* Parameters: capacity - initial number of entries; grows as needed
+* Returns:  Pointer to an empty queue.
+*/
+extern LQ * lq_create(int capacity);
+
+/**
+* Function: lq_free
+* Desc: deallocates all memory associated with lq.
+*/
+extern void lq_free(LQ * lq);
+
+/**
+* Function: lq_push
+* Returns: 1 (0 only if out of memory)
+* Desc: adds the entry <id, priority>; any id is accepted and
+*       earlier entries for the same id are left in place.
+* Runtime:  O(log n)
+*/
+extern int lq_push(LQ * lq, int id, double priority);
+
+/**
+* Function: lq_pop
+* Parameters: int pointer id and double pointer priority ("out")
+* Returns: 1 on success; 0 on failure (empty queue)
+* Desc: removes an entry with minimum priority and stores its
+*       id and priority in *id and *priority.  The entry may be
+*       stale; that is for the caller to decide.
+* Runtime:  O(log n)
+*/
+extern int lq_pop(LQ * lq, int *id, double *priority);
+
+/**
+* Function: lq_top
+* Parameters: int pointer id and double pointer priority ("out")
+* Returns: 1 on success; 0 on failure (empty queue)
+* Desc: stores the id and priority of an entry with minimum
+*       priority in *id and *priority without removing it.
+* Runtime:  O(1)
+*/
+extern int lq_top(LQ * lq, int *id, double *priority);
+
+/**
+* Function: lq_size
+* Returns: number of entries, stale ones included.
+*/
+extern int lq_size(LQ * lq);
+
+/**
+* Function: lq_reset
+* Desc: removes all entries, keeping the allocated array.
+* Runtime:  O(1)
+*/
+extern void lq_reset(LQ * lq);
@@ -0,0 +1,163 @@
+#include "mq.h"
+#include "lq.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define CACHE_LINE 64
+
+/*
+* one sequential heap.  top mirrors the heap's minimum (INFINITY
+*   if empty) so delete_min can compare heaps without locking
+*   them; each heap gets its own cache line so threads working on
+*   different heaps do not contend on the line.
+*/
+typedef struct {
+	_Alignas(CACHE_LINE) pthread_mutex_t lock;
+	LQ* heap;
+	_Atomic double top;
+} SUBQ;
+
+struct mq_struct {
+	SUBQ* subq;
+	int nq;				// number of heaps
+	atomic_int size;
+	int capacity;
+	atomic_uint seed;	// hands out per-thread random seeds
+};
+
+static unsigned next_rand(MQ* mq);
+static void set_top(SUBQ* q);
+
+MQ* mq_create(int capacity, int nthreads, int c) {
+	if(nthreads < 1 || c < 1) {
+		printf("Threads and heaps per thread must be positive.\n");
+		return NULL;
+	}
+
+	MQ* mq = malloc(sizeof(MQ));
+	int i;
+
+	mq->nq = c*nthreads < 2 ? 2 : c*nthreads;
+	mq->subq = aligned_alloc(CACHE_LINE, sizeof(SUBQ)*mq->nq);
+	for(i = 0; i < mq->nq; i++) {
+		pthread_mutex_init(&mq->subq[i].lock, NULL);
+		// every heap starts big enough for its share of the ids
+		mq->subq[i].heap = lq_create(capacity/mq->nq + 1);
+		atomic_init(&mq->subq[i].top, INFINITY);
+	}
+	atomic_init(&mq->size, 0);
+	atomic_init(&mq->seed, 1);
+	mq->capacity = capacity;
+
+	return mq;
+}
+
+void mq_free(MQ* mq) {
+	int i;
+
+	if(mq == NULL)
+		return;
+	for(i = 0; i < mq->nq; i++) {
+		pthread_mutex_destroy(&mq->subq[i].lock);
+		lq_free(mq->subq[i].heap);
+	}
+	free(mq->subq);
+	free(mq);
+}
+
+void mq_reset(MQ* mq) {
+	int i;
+
+	for(i = 0; i < mq->nq; i++) {
+		lq_reset(mq->subq[i].heap);
+		atomic_store(&mq->subq[i].top, INFINITY);
+	}
+	atomic_store(&mq->size, 0);
+}
+
+int mq_insert(MQ* mq, int id, double priority) {
+	SUBQ* q;
+	int ok;
+
+	if(id < 0 || id >= mq->capacity) {
+		printf("ID out of range.\n");
+		return 0;
+	}
+
+	// try random heaps until one is free
+	do
+		q = &mq->subq[next_rand(mq) % mq->nq];
+	while(pthread_mutex_trylock(&q->lock) != 0);
+
+	ok = lq_push(q->heap, id, priority);
+	if(ok) {
+		if(priority < atomic_load_explicit(&q->top, memory_order_relaxed))
+			atomic_store(&q->top, priority);
+		atomic_fetch_add(&mq->size, 1);
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	return ok;
+}
+
+int mq_delete_min(MQ* mq, int *id, double *priority) {
+	SUBQ *a, *b;
+	int ok;
+
+	for(;;) {
+		// the count goes up only after an entry is in a heap, so
+		//   while it is positive some heap has (or just had) one
+		if(atomic_load(&mq->size) <= 0)
+			return 0;
+
+		// the better top of two random heaps
+		a = &mq->subq[next_rand(mq) % mq->nq];
+		b = &mq->subq[next_rand(mq) % mq->nq];
+		if(atomic_load(&b->top) < atomic_load(&a->top))
+			a = b;
+
+		if(pthread_mutex_trylock(&a->lock) != 0)
+			continue;
+		ok = lq_pop(a->heap, id, priority);
+		if(ok) {
+			set_top(a);
+			atomic_fetch_sub(&mq->size, 1);
+		}
+		pthread_mutex_unlock(&a->lock);
+		if(ok)
+			return 1;
+	}
+}
+
+int mq_size(MQ* mq) {
+	return atomic_load(&mq->size);
+}
+
+/**** UTILITY FUNCTIONS *******/
+
+// xorshift32 with a state per thread, seeded on first use
+static unsigned next_rand(MQ* mq) {
+	static _Thread_local unsigned state = 0;
+
+	if(state == 0)
+		state = atomic_fetch_add(&mq->seed, 1) * 2654435761u | 1;
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+// refreshes q->top from its heap; q must be locked
+static void set_top(SUBQ* q) {
+	int id;
+	double top;
+
+	if(!lq_top(q->heap, &id, &top))
+		top = INFINITY;
+	atomic_store(&q->top, top);
+}
+/**** END UTILITY FUNCTIONS *******/
@@ -0,0 +1,79 @@
+/**
+* General description:  relaxed concurrent min-queue (MultiQueue)
+*   of <id, priority> pairs that any number of threads may use at
+*   once.  IDs are integers in [0..N-1], N the capacity set on
+*   creation, and priorities are doubles as in pq.
+*
+*   The queue is c*P sequential heaps (P the number of threads
+*   expected, c a small constant), each behind its own lock.
+*   Insert puts the entry in a random heap whose lock it gets on
+*   the first try; delete_min looks at the tops of two random heaps
+*   and removes the better one.  Threads rarely wait on each other,
+*   at the price of "relaxed" order:  delete_min returns an entry
+*   close to, but not always equal to, the global minimum (with c*P
+*   heaps it is typically among the O(c*P) smallest).
+*
+*   As in lq, an id may be present more than once:  there is no
+*   id -> position map (it would need a global lock), so to lower
+*   an id's priority push it again and skip stale entries when
+*   they come out.  A label-setting search built on this must also
+*   cope with the relaxed order, e.g. by re-relaxing a vertex whose
+*   distance drops after it was popped.
+**/
+
+// "Opaque type" -- definition of mq_struct hidden in mq.c
+typedef struct mq_struct MQ;
+
+/**
+* Function: mq_create
+* Parameters: capacity - number of ids
+*             nthreads - number of threads that will use the queue
+*             c        - heaps per thread (2 is a good default)
+* Returns:  Pointer to empty queue of c*nthreads heaps (at least
+*           2), or NULL if nthreads or c is below 1.
+*/
+extern MQ * mq_create(int capacity, int nthreads, int c);
+
+/**
+* Function: mq_free
+* Desc: deallocates all memory associated with mq.  No other
+*       thread may be using it.
+*/
+extern void mq_free(MQ * mq);
+
+/**
+* Function: mq_reset
+* Desc: removes all entries, keeping the allocated heaps.  No
+*       other thread may be using mq.
+*/
+extern void mq_reset(MQ * mq);
+
+/**
+* Function: mq_insert
+* Returns: 1 on success; 0 on failure.
+*          fails if id is out of range or memory runs out.
+* Desc: adds the entry <id, priority>; earlier entries for the
+*       same id are left in place.  Thread safe.
+* Runtime:  O(log(n/(c*P))) expected, n the number of entries
+*/
+extern int mq_insert(MQ * mq, int id, double priority);
+
+/**
+* Function: mq_delete_min
+* Parameters: int pointer id and double pointer priority ("out")
+* Returns: 1 on success; 0 if the queue was seen empty.
+* Desc: removes an entry with small priority (the smaller of two
+*       random heap tops) and stores its id and priority in *id
+*       and *priority.  Thread safe.  With concurrent inserts a 0
+*       only means the queue was empty at some instant.
+* Runtime:  O(log(n/(c*P))) expected
+*/
+extern int mq_delete_min(MQ * mq, int *id, double *priority);
+
+/**
+* Function: mq_size
+* Returns: number of entries.  Exact when no other thread is
+*          using mq, otherwise a snapshot.
+* Runtime:  O(1)
+*/
+extern int mq_size(MQ * mq);
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include "mq.h"
+
+/*
+* correctness and scaling test for mq.
+*
+*   usage:  mq_test [num_ids [max_threads]]
+*
+*   For T = 1, 2, 4, ... max_threads (and max_threads itself) T
+*   threads share one MultiQueue:  each inserts its share of the
+*   ids 0..num_ids-1, deleting one minimum after every insert as
+*   a search would, and then all threads drain the queue.  Every
+*   id must come out exactly once with the priority it went in
+*   with.  Operations per second are reported for each T.
+*/
+
+#define DEFAULT_IDS 1000000
+#define HEAPS_PER_THREAD 2
+
+MQ *mq;					// queue under test
+int num_ids;
+int num_threads;
+atomic_int *seen;		// times each id came out
+
+static double id_priority(int id);
+static void take(int id, double priority);
+static void *worker(void *arg);
+static double now(void);
+
+int main(int argc, char **argv) {
+	int max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int t, i, bad, last;
+	pthread_t *threads;
+	double start, secs;
+
+	num_ids = argc > 1 ? atoi(argv[1]) : DEFAULT_IDS;
+	if(argc > 2)
+		max_threads = atoi(argv[2]);
+	if(num_ids < 1 || max_threads < 1) {
+		printf("usage:  mq_test [num_ids [max_threads]]\n");
+		return 1;
+	}
+
+	seen = malloc(sizeof(atomic_int) * num_ids);
+	threads = malloc(sizeof(pthread_t) * max_threads);
+	printf("%d ids, %d heaps per thread\n", num_ids, HEAPS_PER_THREAD);
+
+	last = 0;
+	for(num_threads = 1; last != max_threads; num_threads *= 2) {
+		if(num_threads > max_threads)
+			num_threads = max_threads;
+		last = num_threads;
+
+		mq = mq_create(num_ids, num_threads, HEAPS_PER_THREAD);
+		for(i = 0; i < num_ids; i++)
+			atomic_init(&seen[i], 0);
+
+		start = now();
+		for(t = 0; t < num_threads; t++)
+			pthread_create(&threads[t], NULL, worker, (void *)(long)t);
+		for(t = 0; t < num_threads; t++)
+			pthread_join(threads[t], NULL);
+		secs = now() - start;
+
+		// every id exactly once, and nothing left behind
+		bad = mq_size(mq) != 0;
+		for(i = 0; i < num_ids; i++)
+			if(atomic_load(&seen[i]) != 1)
+				bad++;
+		printf("%3d threads:  %8.2f M ops/s  %s\n", num_threads,
+			2.0 * num_ids / secs / 1e6, bad ? "FAILED" : "ok");
+		mq_free(mq);
+		if(bad) {
+			printf("%d ids did not come out exactly once\n", bad);
+			return 1;
+		}
+	}
+
+	free(threads);
+	free(seen);
+	return 0;
+}
+
+// a priority that depends only on the id, so it can be checked
+static double id_priority(int id) {
+	return (double)((id * 2654435761u) % 1000003u);
+}
+
+// records that id came out of the queue with priority
+static void take(int id, double priority) {
+	if(id < 0 || id >= num_ids || priority != id_priority(id)) {
+		printf("bad entry <%d, %.0f>\n", id, priority);
+		exit(1);
+	}
+	atomic_fetch_add(&seen[id], 1);
+}
+
+static void *worker(void *arg) {
+	int t = (int)(long)arg;
+	int i, id;
+	double priority;
+
+	// insert this thread's ids, deleting a minimum after each
+	for(i = t; i < num_ids; i += num_threads) {
+		if(!mq_insert(mq, i, id_priority(i))) {
+			printf("insert of %d failed\n", i);
+			exit(1);
+		}
+		if(mq_delete_min(mq, &id, &priority))
+			take(id, priority);
+	}
+	// then drain:  0 means no entry was left to take
+	while(mq_delete_min(mq, &id, &priority))
+		take(id, priority);
+	return NULL;
+}
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
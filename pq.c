@@ -2,178 +2,307 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-typedef struct heap {
-	int id;
-	int heap_index;
-	double priority;
-} HEAP;
-
+#define CACHE_LINE 64
+
+/* pq_insert_bulk and pq_change_priority_bulk sift the entries
+*    they touch one at a time when there are at most
+*    1/BULK_SIFT_RATIO as many as already queued (k log n < n + k),
+*    else rebuild the heap bottom-up.
+*/
+#define BULK_SIFT_RATIO 8
+
+/*
+* d-ary heap in three parallel arrays indexed by heap position
+*   (root at 0, children of i at d*i+1 .. d*i+d).  Sifting only
+*   compares priorities, so they get their own array; it is
+*   shifted by d-1 slots from a cache-line aligned base so that
+*   the d children of a node (d*8 <= 64 bytes) always start on a
+*   multiple of d*8 bytes and share one cache line.
+*/
 struct pq_struct {
-	HEAP* heap;
-	HEAP** id_ptrs;
+	double* prio;		// priority at each heap position
+	int* ids;			// id at each heap position
+	int* pos;			// heap position of each id; -1 if absent
+	double* prio_base;	// allocation behind prio
 	int size;
 	int capacity;
-	int is_min_heap;
+	int arity;
+	int log_arity;		// arity is a power of two:  levels step by shifts
+	int (*before)(double a, double b);	// a belongs above b
+	int (*sift_up)(PQ* pq, int index);
+	int (*sift_down)(PQ* pq, int index);
 };
 
+/*
+* sifting moves a hole instead of swapping:  the entry being
+*   placed is held aside while entries it must pass are shifted
+*   into the hole one write per level, and it is stored once at
+*   the end.  The min-heap and max-heap versions are generated
+*   from this macro with BEFORE(a, b) true when priority a 
+*   belongs above priority b; pq_create picks one pair so no
+*   operation tests whether the heap is a min-heap.
+*
+*   Both return the final position of the entry.
+*/
+#define PQ_SIFT_FUNCS(SFX, BEFORE)					\
+static int before_##SFX(double a, double b) {				\
+	return BEFORE(a, b);						\
+}									\
+									\
+static int sift_up_##SFX(PQ* pq, int index) {				\
+	int id = pq->ids[index];					\
+	double priority = pq->prio[index];				\
+	int parent_index;						\
+									\
+	while(index > 0) {						\
+		parent_index = (index-1) >> pq->log_arity;		\
+		if(!BEFORE(priority, pq->prio[parent_index]))		\
+			break;						\
+		pq->prio[index] = pq->prio[parent_index];		\
+		pq->ids[index] = pq->ids[parent_index];			\
+		pq->pos[pq->ids[index]] = index;			\
+		index = parent_index;					\
+	}								\
+	pq->prio[index] = priority;					\
+	pq->ids[index] = id;						\
+	pq->pos[id] = index;						\
+	return index;							\
+}									\
+									\
+static int sift_down_##SFX(PQ* pq, int index) {				\
+	int id = pq->ids[index];					\
+	double priority = pq->prio[index];				\
+	int best, child, last;						\
+	int first = (index << pq->log_arity) + 1;			\
+									\
+	while(first < pq->size) {					\
+		/* best of the (up to) arity children */		\
+		best = first;						\
+		last = first + pq->arity;				\
+		if(last > pq->size)					\
+			last = pq->size;				\
+		for(child = first+1; child < last; child++)		\
+			if(BEFORE(pq->prio[child], pq->prio[best]))	\
+				best = child;				\
+		if(!BEFORE(pq->prio[best], priority))			\
+			break;						\
+		pq->prio[index] = pq->prio[best];			\
+		pq->ids[index] = pq->ids[best];				\
+		pq->pos[pq->ids[index]] = index;			\
+		index = best;						\
+		first = (index << pq->log_arity) + 1;			\
+	}								\
+	pq->prio[index] = priority;					\
+	pq->ids[index] = id;						\
+	pq->pos[id] = index;						\
+	return index;							\
+}
+
+#define PQ_LESS(a, b) ((a) < (b))
+#define PQ_GREATER(a, b) ((a) > (b))
+
+PQ_SIFT_FUNCS(min, PQ_LESS)
+PQ_SIFT_FUNCS(max, PQ_GREATER)
+
+// restores heap order around an entry whose priority changed
+static void resift(PQ* pq, int index) {
+	if(pq->sift_up(pq, index) == index)
+		pq->sift_down(pq, index);
+}
+
+// restores heap order over the whole array, bottom-up
+static void heapify(PQ* pq) {
+	int i;
+
+	for(i = (pq->size-2) / pq->arity; i >= 0; i--)
+		pq->sift_down(pq, i);
+}
+
 PQ* pq_create(int capacity, int min_heap) {
+	return pq_create_dary(capacity, min_heap, 2);
+}
+
+PQ* pq_create_dary(int capacity, int min_heap, int arity) {
+	if(arity != 2 && arity != 4 && arity != 8) {
+		printf("Arity must be 2, 4 or 8.\n");
+		return NULL;
+	}
+
 	PQ* pq = malloc(sizeof(PQ));
-	pq->heap = malloc(sizeof(HEAP)*(capacity+1));
-	pq->id_ptrs = malloc(sizeof(HEAP*)*capacity);
+	size_t prio_bytes = sizeof(double)*(capacity+arity-1);
+	prio_bytes = (prio_bytes + CACHE_LINE-1) / CACHE_LINE * CACHE_LINE;	// aligned_alloc wants a multiple
+	pq->prio_base = aligned_alloc(CACHE_LINE, prio_bytes);
+	pq->prio = pq->prio_base + arity-1;
+	pq->ids = malloc(sizeof(int)*capacity);
+	pq->pos = malloc(sizeof(int)*capacity);
 	pq->size = 0;
 	pq->capacity = capacity;
-	pq->is_min_heap = min_heap;
+	pq->arity = arity;
+	pq->log_arity = arity == 2 ? 1 : arity == 4 ? 2 : 3;
+	pq->before = min_heap ? before_min : before_max;
+	pq->sift_up = min_heap ? sift_up_min : sift_up_max;
+	pq->sift_down = min_heap ? sift_down_min : sift_down_max;
 
 	int i;
 	for(i = 0; i < capacity; i++)
-		pq->id_ptrs[i] = NULL;
+		pq->pos[i] = -1;
 
 	return pq;
 }
 
-void pq_free(PQ* pq) {
-	if(pq->heap != NULL)
-		free(pq->heap);
-	if(pq->id_ptrs != NULL)
-		free(pq->id_ptrs);
-	if(pq != NULL)
-		free(pq);
+PQ* pq_create_bulk(int capacity, int min_heap, int arity, int* ids, double* priorities, int n) {
+	PQ* pq = pq_create_dary(capacity, min_heap, arity);
+
+	if(pq != NULL && !pq_insert_bulk(pq, ids, priorities, n)) {
+		pq_free(pq);
+		return NULL;
+	}
+	return pq;
 }
 
-void pq_swap(PQ* pq, int index_1, int index_2) {
-	int id_1 = pq->heap[index_1].id;
-	double priority_1 = pq->heap[index_1].priority;
+void pq_free(PQ* pq) {
+	if(pq == NULL)
+		return;
+	free(pq->prio_base);
+	free(pq->ids);
+	free(pq->pos);
+	free(pq);
+}
 
-	int id_2 = pq->heap[index_2].id;
-	double priority_2 = pq->heap[index_2].priority;
+int pq_insert(PQ* pq, int id, double priority) {
+	if(id < 0 || id >= pq->capacity) {
+		printf("ID out of range.\n");
+		return 0;
+	}
 
-	pq->heap[index_1].id = id_2;
-	pq->heap[index_1].priority = priority_2;
+	if(pq->pos[id] != -1) {
+		printf("ID in use.\n");
+		return 0;
+	}
 
-	pq->heap[index_2].id = id_1;
-	pq->heap[index_2].priority = priority_1;
+	if(pq->size >= pq->capacity) {
+		printf("Full is priority queue.\n");
+		return 0;
+	}
 
-	pq->id_ptrs[id_1] = &(pq->heap[index_2]);
-	pq->id_ptrs[id_2] = &(pq->heap[index_1]);
-}
+	int index = pq->size++;
+	pq->ids[index] = id;
+	pq->prio[index] = priority;	// insert data at the end of the array
+	pq->pos[id] = index;			// label the id of the data as IDs
 
-void percolate_down_max(PQ* pq, int index) {
-	int max, done = 0;
-	int left_index = 2*index;
-	int right_index = left_index+1;
-
-	while(left_index <= pq->size && !done) {
-		max = left_index;
-		if(right_index <= pq->size)
-			if(pq->heap[left_index].priority < pq->heap[right_index].priority)
-				max = right_index;
-		if(pq->heap[max].priority > pq->heap[index].priority) {
-			pq_swap(pq, max, index);
-			index = max;
-		}
-		else
-			done = 1;
+	pq->sift_up(pq, index);
 
-		left_index = 2*index;
-		right_index = left_index+1;
-	}	
+	return 1;
 }
 
-void percolate_down_min(PQ* pq, int index) {
-	int min, done = 0;
-	int left_index = 2*index;
-	int right_index = left_index+1;
-
-	while(left_index <= pq->size && !done) {
-		min = left_index;
+int pq_insert_bulk(PQ* pq, int* ids, double* priorities, int n) {
+	int i, id;
 
-		if(right_index <= pq->size)
-			if(pq->heap[left_index].priority > pq->heap[right_index].priority)
-				min = right_index;
+	if(n < 0 || pq->size + n > pq->capacity) {
+		printf("Full is priority queue.\n");
+		return 0;
+	}
 
-		if(pq->heap[min].priority < pq->heap[index].priority) {
-			pq_swap(pq, min, index);
-			index = min;
+	// append everything (ids checked as we go) ...
+	int old_size = pq->size;
+	for(i = 0; i < n; i++) {
+		id = ids != NULL ? ids[i] : i;
+		if(id < 0 || id >= pq->capacity || pq->pos[id] != -1) {
+			if(id < 0 || id >= pq->capacity)
+				printf("ID out of range.\n");
+			else
+				printf("ID in use.\n");
+			// undo the appends so far
+			while(--i >= 0)
+				pq->pos[pq->ids[old_size+i]] = -1;
+			pq->size = old_size;
+			return 0;
 		}
-		else
-			done = 1;
-
-		left_index = 2*index;
-		right_index = left_index+1;
-	}	
-}
+		pq->ids[pq->size] = id;
+		pq->prio[pq->size] = priorities[i];
+		pq->pos[id] = pq->size++;
+	}
 
-void percolate_down(PQ* pq, int index) {
-	int parent_index = index/2;
-	
-	if(pq->is_min_heap)
-		percolate_down_min(pq, index);
+	// ... then restore heap order:  a few entries are sifted up
+	//   one by one, many are merged by heapifying the whole array
+	if(n <= old_size / BULK_SIFT_RATIO) {
+		for(i = old_size; i < pq->size; i++)
+			pq->sift_up(pq, i);
+	}
 	else
-		percolate_down_max(pq, index);
-}
+		heapify(pq);
 
-void percolate_up(PQ* pq, int index) {
-	int parent_index = index/2;
-	
-	if(pq->is_min_heap) {
-		while(parent_index >= 1 && pq->heap[parent_index].priority > pq->heap[index].priority) {
-			pq_swap(pq, index, parent_index);
-			index = parent_index;
-			parent_index = index/2;
-		}
-	}
-	else {
-		while(parent_index >= 1 && pq->heap[parent_index].priority < pq->heap[index].priority) {
-			pq_swap(pq, index, parent_index);
-			index = parent_index;
-			parent_index = index/2;
-		}
-	}
+	return 1;
 }
 
-int pq_insert(PQ* pq, int id, double priority) {
+int pq_change_priority(PQ* pq, int id, double new_priority) {
 	if(id < 0 || id >= pq->capacity) {
 		printf("ID out of range.\n");
 		return 0;
 	}
 
-	if(pq->id_ptrs[id] != NULL) {
-		printf("ID in use.\n");
+	if(pq->pos[id] == -1) {
+		printf("ID not in use.\n");
 		return 0;
 	}
 
-	if(pq->size >= pq->capacity) {
-		printf("Full is priority queue.\n");
-		return 0;
-	}
+	int index = pq->pos[id];
+	pq->prio[index] = new_priority;
+	resift(pq, index);
 
-	int index = ++pq->size;
-	pq->heap[index].id = id;
-	pq->heap[index].heap_index = index;
-	pq->heap[index].priority = priority;	// insert data at the end of the array
-	pq->id_ptrs[id] = &(pq->heap[index]);		// label the id of the data as IDs
+	return 1;
+}
 
-	percolate_up(pq, index);
+int pq_change_priority_bulk(PQ* pq, int* ids, double* priorities, int n) {
+	int i;
+
+	// check every id first so a failure changes nothing
+	for(i = 0; i < n; i++) {
+		if(ids[i] < 0 || ids[i] >= pq->capacity) {
+			printf("ID out of range.\n");
+			return 0;
+		}
+		if(pq->pos[ids[i]] == -1) {
+			printf("ID not in use.\n");
+			return 0;
+		}
+	}
+
+	// few changes are resifted one by one, many are written in
+	//   place and the heap rebuilt once
+	if(n <= pq->size / BULK_SIFT_RATIO) {
+		for(i = 0; i < n; i++) {
+			pq->prio[pq->pos[ids[i]]] = priorities[i];
+			resift(pq, pq->pos[ids[i]]);
+		}
+	}
+	else {
+		for(i = 0; i < n; i++)
+			pq->prio[pq->pos[ids[i]]] = priorities[i];
+		heapify(pq);
+	}
 
 	return 1;
 }
 
-int pq_change_priority(PQ* pq, int id, double new_priority) {
+int pq_decrease_key(PQ* pq, int id, double new_priority) {
 	if(id < 0 || id >= pq->capacity) {
 		printf("ID out of range.\n");
 		return 0;
 	}
 
-	if(pq->id_ptrs[id] == NULL) {
+	if(pq->pos[id] == -1) {
 		printf("ID not in use.\n");
 		return 0;
 	}
 
-	pq->id_ptrs[id]->priority = new_priority;
-
-	int index = pq->id_ptrs[id]->heap_index;
-	percolate_up(pq, index);
-	percolate_down(pq, index);
+	int index = pq->pos[id];
+	if(pq->before(pq->prio[index], new_priority)) {
+		printf("Priority moves away from top.\n");
+		return 0;
+	}
+	pq->prio[index] = new_priority;
+	pq->sift_up(pq, index);
 
 	return 1;
 }
@@ -184,7 +313,7 @@ int pq_remove_by_id(PQ* pq, int id) {
 		return 0;
 	}
 
-	if(pq->id_ptrs[id] == NULL) {
+	if(pq->pos[id] == -1) {
 		printf("ID not in use.\n");
 		return 0;
 	}
@@ -195,29 +324,19 @@ int pq_remove_by_id(PQ* pq, int id) {
 		return 0;
 	}
 
-	if(pq_size == 1 || pq->id_ptrs[id]->heap_index == pq_size) {
-		pq->id_ptrs[id] = NULL;		// remove the location label
-		pq->size--;
+	int index = pq->pos[id];
+	pq->pos[id] = -1;		// remove the location label
+	pq->size--;
 
+	if(index == pq_size-1)
 		return 1;
-	}
-
-	int new_id;
-	double new_priority;
 
-	new_id = pq->heap[pq_size].id;								// copy data from the last data set
-	new_priority = pq->heap[pq_size].priority;
+	int new_id = pq->ids[pq_size-1];				// copy data from the last data set
+	pq->ids[index] = new_id;						// replace the data from the id specified
+	pq->prio[index] = pq->prio[pq_size-1];
+	pq->pos[new_id] = index;						// update the label location of the copied data
 
-	pq->id_ptrs[id]->id = new_id;								// replace the data from the id specified
-	pq->id_ptrs[id]->priority = new_priority;
-	pq->id_ptrs[new_id] = pq->id_ptrs[id];						// update the label location of the copied data
-	
-	pq->id_ptrs[id] = NULL;		// remove the location label
-	pq->size--;
-
-	int index = pq->id_ptrs[new_id]->heap_index;
-	percolate_up(pq, index);
-	percolate_down(pq, index);
+	resift(pq, index);
 
 	return 1;
 }
@@ -228,12 +347,12 @@ int pq_get_priority(PQ* pq, int id, double *priority) {
 		return 0;
 	}
 
-	if(pq->id_ptrs[id] == NULL) {
+	if(pq->pos[id] == -1) {
 		printf("ID not in use.\n");
 		return 0;
 	}
 
-	*priority = pq->id_ptrs[id]->priority;
+	*priority = pq->prio[pq->pos[id]];
 
 	return 1;
 }
@@ -245,22 +364,65 @@ int pq_delete_top(PQ* pq, int *id, double *priority) {
 		return 0;
 	}
 
-	*id = pq->heap[1].id;
-	*priority = pq->heap[1].priority;
+	*id = pq->ids[0];
+	*priority = pq->prio[0];
 
 	if(pq_size > 1) {
-		int new_id = pq->heap[pq_size].id;
-		double new_priority = pq->heap[pq_size].priority;
-		pq->heap[1].id = new_id;
-		pq->heap[1].priority = new_priority;
-		pq->id_ptrs[new_id] = &(pq->heap[1]);		
+		int new_id = pq->ids[pq_size-1];
+		pq->ids[0] = new_id;
+		pq->prio[0] = pq->prio[pq_size-1];
+		pq->pos[new_id] = 0;
 	}
 
-	pq->id_ptrs[*id] = NULL;
+	pq->pos[*id] = -1;
 	pq->size--;
 
 	if(pq_size > 1)
-		percolate_down(pq, 1);
+		pq->sift_down(pq, 0);
+
+	return 1;
+}
+
+void pq_reset(PQ* pq) {
+	int i;
+
+	// ids no longer queued were unlabelled when they left
+	for(i = 0; i < pq->size; i++)
+		pq->pos[pq->ids[i]] = -1;
+	pq->size = 0;
+}
+
+int pq_grow(PQ* pq, int capacity) {
+	int i;
+
+	if(capacity <= pq->capacity)
+		return 1;
+
+	size_t prio_bytes = sizeof(double)*(capacity+pq->arity-1);
+	prio_bytes = (prio_bytes + CACHE_LINE-1) / CACHE_LINE * CACHE_LINE;
+	double* prio_base = aligned_alloc(CACHE_LINE, prio_bytes);	// realloc would lose the alignment
+	int* ids = realloc(pq->ids, sizeof(int)*capacity);
+	int* pos = realloc(pq->pos, sizeof(int)*capacity);
+	if(prio_base == NULL || ids == NULL || pos == NULL) {
+		printf("Out of memory.\n");
+		free(prio_base);
+		if(ids != NULL)
+			pq->ids = ids;
+		if(pos != NULL)
+			pq->pos = pos;
+		return 0;
+	}
+
+	for(i = 0; i < pq->size; i++)
+		prio_base[pq->arity-1+i] = pq->prio[i];
+	free(pq->prio_base);
+	pq->prio_base = prio_base;
+	pq->prio = prio_base + pq->arity-1;
+	pq->ids = ids;
+	pq->pos = pos;
+	for(i = pq->capacity; i < capacity; i++)
+		pq->pos[i] = -1;
+	pq->capacity = capacity;
 
 	return 1;
 }
@@ -273,6 +435,10 @@ int pq_size(PQ* pq) {
 	return pq->size;
 }
 
+int pq_arity(PQ* pq) {
+	return pq->arity;
+}
+
 int pq_contains(PQ* pq, int id) {
-	return pq->id_ptrs[id] != NULL;
+	return pq->pos[id] != -1;
 }
@@ -6,7 +6,7 @@
 *
 *   There can be only one (or zero) entry for a particular id.
 *
-*   Capacity is fixed on creation.
+*   Capacity is set on creation and can be raised with pq_grow.
 *
 *   IDs are integers in the range [0..N-1] where N is the capacity
 *   of the priority queue set on creation.  Any values outside this
@@ -31,6 +31,42 @@ typedef struct pq_struct PQ;
 */
 extern PQ * pq_create(int capacity, int min_heap);
 
+/**
+* Function: pq_create_dary
+* Parameters: capacity, min_heap - as in pq_create
+*             arity - number of children per heap node: 2, 4 or 8
+*
+* Returns:  Pointer to empty priority queue as pq_create (which
+*           is the same as arity 2), or NULL if arity is invalid.
+*
+* Desc: a wider heap is shallower:  insert and change_priority
+*       take fewer steps (log_d n), while each step of
+*       delete_top compares all d children.  Priorities are laid
+*       out so the d children of a node share one cache line, so
+*       those compares cost about one memory access.  Arity 4 is
+*       usually the fastest for Dijkstra-style workloads.
+*
+*/
+extern PQ * pq_create_dary(int capacity, int min_heap, int arity);
+
+/**
+* Function: pq_create_bulk
+* Parameters: capacity, min_heap, arity - as in pq_create_dary
+*             ids, priorities - n entries to start with; ids may
+*                      be NULL, meaning ids 0..n-1
+*             n - number of entries
+*
+* Returns:  Pointer to a priority queue holding the n entries, or
+*           NULL if arity is invalid or pq_insert_bulk would fail.
+*
+* Desc: builds the heap bottom-up in one pass, which is cheaper
+*       than n calls to pq_insert.
+*
+* Runtime:  O(capacity + n)
+*/
+extern PQ * pq_create_bulk(int capacity, int min_heap, int arity,
+				int *ids, double *priorities, int n);
+
 /**
 * Function: pq_free
 * Parameters: PQ * pq
@@ -58,6 +94,26 @@ extern void pq_free(PQ * pq);
 */
 extern int pq_insert(PQ * pq, int id, double priority);
 
+/**
+* Function: pq_insert_bulk
+* Parameters: priority queue pq
+*             ids, priorities - n entries to insert; ids may be
+*                      NULL, meaning ids 0..n-1
+*             n - number of entries
+* Returns: 1 on success; 0 on failure.
+*          fails if any id is out of range or already in use
+*            (including twice in ids), or the entries do not fit;
+*          pq is unchanged on failure.
+*
+* Desc: same as n calls to pq_insert, but when n is large
+*       compared to pq_size the heap is rebuilt bottom-up
+*       instead of sifting each entry up.
+*
+* Runtime:  O(n log(size)) for few entries, O(size + n) otherwise
+*
+*/
+extern int pq_insert_bulk(PQ * pq, int *ids, double *priorities, int n);
+
 /**
 * Function: pq_change_priority
 * Parameters: priority queue ptr pq
@@ -73,6 +129,43 @@ extern int pq_insert(PQ * pq, int id, double priority);
 */
 extern int pq_change_priority(PQ * pq, int id, double new_priority);
 
+/**
+* Function: pq_change_priority_bulk
+* Parameters: priority queue ptr pq
+*             ids, priorities - n (id, new_priority) pairs
+*             n - number of pairs
+* Returns: 1 on success; 0 on failure.
+*          fails if any id is out of range or not in pq;
+*          pq is unchanged on failure.
+*
+* Desc: same as n calls to pq_change_priority (if an id appears
+*       more than once its last priority wins), but when n is
+*       large compared to pq_size the new priorities are all
+*       written first and the heap rebuilt bottom-up once.
+*
+* Runtime:  O(n log(size)) for few pairs, O(size + n) otherwise
+*
+*/
+extern int pq_change_priority_bulk(PQ * pq, int *ids, double *priorities, int n);
+
+/**
+* Function: pq_decrease_key
+* Parameters: priority queue ptr pq
+*             element id
+*             new_priority
+* Returns: 1 on success; 0 on failure
+* Desc: like pq_change_priority for the common case where the
+*       entry moves toward the top (new_priority <= current for
+*       a min-heap, >= for a max-heap), e.g. edge relaxation in
+*       Dijkstra.  Only sifts up, so it does about half the work
+*       of pq_change_priority.
+*       Fails if id is not in pq, out of range, or new_priority
+*       would move the entry away from the top.
+* Runtime:  O(log n)
+*
+*/
+extern int pq_decrease_key(PQ * pq, int id, double new_priority);
+
 /**
 * Function: pq_remove_by_id
 * Parameters: priority queue pq, 
@@ -118,6 +211,33 @@ extern int pq_get_priority(PQ * pq, int id, double *priority);
 */
 extern int pq_delete_top(PQ * pq, int *id, double *priority);
 
+/**
+* Function: pq_reset
+* Parameters: priority queue pq
+* Returns: --
+* Desc: removes all entries, leaving pq as if just created (same
+*       capacity, arity and min/max behavior) without allocating.
+*       Lets one queue serve many searches.
+*
+* Runtime:  O(size), not O(capacity)
+*
+*/
+extern void pq_reset(PQ * pq);
+
+/**
+* Function: pq_grow
+* Parameters: priority queue pq
+*             capacity - new capacity
+* Returns: 1 on success; 0 on failure (out of memory, pq unchanged)
+* Desc: raises the capacity (and so the range of valid IDs) to
+*       capacity, keeping all entries.  A smaller or equal
+*       capacity leaves pq unchanged and succeeds.
+*
+* Runtime:  O(new capacity)
+*
+*/
+extern int pq_grow(PQ * pq, int capacity);
+
 /**
 * Function:  pq_capacity
 * Parameters: priority queue pq
@@ -139,6 +259,15 @@ extern int pq_capacity(PQ * pq);
 */
 extern int pq_size(PQ * pq);
 
+/**
+* Function: pq_arity
+* Parameters: priority queue pq
+* Returns: number of children per heap node (as set on creation)
+*
+* Runtime:  O(1)
+*/
+extern int pq_arity(PQ * pq);
+
 /**
 * Function: pq_contains
 * Parameters: priority queue pq
@@ -0,0 +1,244 @@
+#include "rheap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define NBUCKETS 65
+#define INIT_BUCKET_CAP 8
+#define MAX_INT_KEY 9007199254740992.0	// 2^53
+
+/*
+* bucket 0 holds keys equal to last (the last minimum); bucket
+*   b > 0 holds keys whose highest bit differing from last is bit
+*   b-1.  Every key in bucket b is smaller than every key in a
+*   higher bucket, and none is below last.
+*/
+struct rheap_struct {
+	uint64_t* key;		// key of each id
+	double* prio;		// priority of each id, as given
+	int* bucket;		// bucket of each id; -1 if absent
+	int* slot;			// index of each id within its bucket
+	int* ids[NBUCKETS];	// ids in each bucket, unordered
+	int count[NBUCKETS];
+	int cap[NBUCKETS];
+	uint64_t nonempty;	// bit b-1 set iff bucket b > 0 is nonempty
+	uint64_t last;
+	int size;
+	int capacity;
+	int key_type;
+};
+
+static int to_key(RHEAP* rh, double priority, uint64_t* key);
+static int bucket_for(RHEAP* rh, uint64_t key);
+static void bucket_add(RHEAP* rh, int b, int id);
+static void bucket_remove(RHEAP* rh, int id);
+
+RHEAP* rheap_create(int capacity, int key_type) {
+	RHEAP* rh = malloc(sizeof(RHEAP));
+	rh->key = malloc(sizeof(uint64_t)*capacity);
+	rh->prio = malloc(sizeof(double)*capacity);
+	rh->bucket = malloc(sizeof(int)*capacity);
+	rh->slot = malloc(sizeof(int)*capacity);
+	rh->nonempty = 0;
+	rh->last = 0;
+	rh->size = 0;
+	rh->capacity = capacity;
+	rh->key_type = key_type;
+
+	int i;
+	for(i = 0; i < capacity; i++)
+		rh->bucket[i] = -1;
+	for(i = 0; i < NBUCKETS; i++) {
+		rh->ids[i] = NULL;
+		rh->count[i] = 0;
+		rh->cap[i] = 0;
+	}
+
+	return rh;
+}
+
+void rheap_free(RHEAP* rh) {
+	int i;
+
+	if(rh == NULL)
+		return;
+	for(i = 0; i < NBUCKETS; i++)
+		free(rh->ids[i]);
+	free(rh->key);
+	free(rh->prio);
+	free(rh->bucket);
+	free(rh->slot);
+	free(rh);
+}
+
+void rheap_reset(RHEAP* rh) {
+	int b, i;
+
+	for(b = 0; b < NBUCKETS; b++) {
+		for(i = 0; i < rh->count[b]; i++)
+			rh->bucket[rh->ids[b][i]] = -1;
+		rh->count[b] = 0;
+	}
+	rh->nonempty = 0;
+	rh->last = 0;
+	rh->size = 0;
+}
+
+int rheap_insert(RHEAP* rh, int id, double priority) {
+	uint64_t key;
+
+	if(id < 0 || id >= rh->capacity) {
+		printf("ID out of range.\n");
+		return 0;
+	}
+
+	if(rh->bucket[id] != -1) {
+		printf("ID in use.\n");
+		return 0;
+	}
+
+	if(!to_key(rh, priority, &key))
+		return 0;
+
+	rh->key[id] = key;
+	rh->prio[id] = priority;
+	bucket_add(rh, bucket_for(rh, key), id);
+	rh->size++;
+
+	return 1;
+}
+
+int rheap_decrease_key(RHEAP* rh, int id, double new_priority) {
+	uint64_t key;
+
+	if(id < 0 || id >= rh->capacity) {
+		printf("ID out of range.\n");
+		return 0;
+	}
+
+	if(rh->bucket[id] == -1) {
+		printf("ID not in use.\n");
+		return 0;
+	}
+
+	if(!to_key(rh, new_priority, &key))
+		return 0;
+
+	if(key > rh->key[id]) {
+		printf("Priority moves away from top.\n");
+		return 0;
+	}
+
+	rh->key[id] = key;
+	rh->prio[id] = new_priority;
+	int b = bucket_for(rh, key);
+	if(b != rh->bucket[id]) {
+		bucket_remove(rh, id);
+		bucket_add(rh, b, id);
+	}
+
+	return 1;
+}
+
+int rheap_delete_min(RHEAP* rh, int *id, double *priority) {
+	int b, i, n, moved;
+	uint64_t min;
+
+	if(rh->size == 0) {
+		printf("Empty priority queue.\n");
+		return 0;
+	}
+
+	if(rh->count[0] == 0) {
+		// lowest nonempty bucket holds the minimum; make it the new
+		//   last and spread the bucket's entries over lower buckets
+		b = __builtin_ctzll(rh->nonempty) + 1;
+		min = rh->key[rh->ids[b][0]];
+		for(i = 1; i < rh->count[b]; i++)
+			if(rh->key[rh->ids[b][i]] < min)
+				min = rh->key[rh->ids[b][i]];
+		rh->last = min;
+
+		n = rh->count[b];
+		rh->count[b] = 0;
+		rh->nonempty &= ~(1ull << (b-1));
+		for(i = 0; i < n; i++) {
+			moved = rh->ids[b][i];
+			bucket_add(rh, bucket_for(rh, rh->key[moved]), moved);
+		}
+	}
+
+	*id = rh->ids[0][--rh->count[0]];
+	*priority = rh->prio[*id];
+	rh->bucket[*id] = -1;
+	rh->size--;
+
+	return 1;
+}
+
+int rheap_size(RHEAP* rh) {
+	return rh->size;
+}
+
+int rheap_contains(RHEAP* rh, int id) {
+	return rh->bucket[id] != -1;
+}
+
+/**** UTILITY FUNCTIONS *******/
+
+// maps a priority to its key; 0 (with a message) if invalid
+static int to_key(RHEAP* rh, double priority, uint64_t* key) {
+	if(!(priority >= 0.0)) {	// also rejects NaN
+		printf("Priority must be non-negative.\n");
+		return 0;
+	}
+
+	if(rh->key_type == RHEAP_INT_KEYS) {
+		if(priority >= MAX_INT_KEY || priority != (double)(uint64_t)priority) {
+			printf("Priority must be a whole number.\n");
+			return 0;
+		}
+		*key = (uint64_t)priority;
+	}
+	else {
+		priority += 0.0;	// turns -0.0 into +0.0
+		memcpy(key, &priority, sizeof(uint64_t));
+	}
+
+	if(*key < rh->last) {
+		printf("Priority below last minimum.\n");
+		return 0;
+	}
+	return 1;
+}
+
+static int bucket_for(RHEAP* rh, uint64_t key) {
+	if(key == rh->last)
+		return 0;
+	return 64 - __builtin_clzll(key ^ rh->last);
+}
+
+static void bucket_add(RHEAP* rh, int b, int id) {
+	if(rh->count[b] == rh->cap[b]) {
+		rh->cap[b] = rh->cap[b] ? 2*rh->cap[b] : INIT_BUCKET_CAP;
+		rh->ids[b] = realloc(rh->ids[b], sizeof(int)*rh->cap[b]);
+	}
+	rh->bucket[id] = b;
+	rh->slot[id] = rh->count[b];
+	rh->ids[b][rh->count[b]++] = id;
+	if(b > 0)
+		rh->nonempty |= 1ull << (b-1);
+}
+
+// the bucket's last id fills the hole
+static void bucket_remove(RHEAP* rh, int id) {
+	int b = rh->bucket[id];
+	int moved = rh->ids[b][--rh->count[b]];
+
+	rh->ids[b][rh->slot[id]] = moved;
+	rh->slot[moved] = rh->slot[id];
+	if(rh->count[b] == 0 && b > 0)
+		rh->nonempty &= ~(1ull << (b-1));
+}
+/**** END UTILITY FUNCTIONS *******/
@@ -0,0 +1,94 @@
+/**
+* General description:  monotone priority queue (radix heap)
+*   storing pairs <id, priority> with the same id model as pq:
+*   IDs are integers in [0..N-1], N the capacity set on creation,
+*   and there is at most one entry per id.  The top is always the
+*   minimum priority.
+*
+*   "Monotone" means priorities never go below the priority most
+*   recently returned by rheap_delete_min; inserting or decreasing
+*   to a smaller priority fails.  Dijkstra's algorithm with
+*   non-negative edge lengths satisfies this.
+*
+*   Priorities are mapped to 64 bit keys and entries sit in 65
+*   buckets by the highest bit in which their key differs from the
+*   last minimum.  Each entry moves to a lower bucket at most 64
+*   times over its life, so delete_min is O(1) amortized per bit
+*   instead of O(log n) comparisons, and insert and decrease_key
+*   are O(1).
+*
+*   Keys are either:
+*     RHEAP_INT_KEYS:     priorities must be non-negative whole
+*                         numbers (< 2^53); the key is the number.
+*     RHEAP_DOUBLE_KEYS:  priorities may be any non-negative
+*                         double; the key is its IEEE bit pattern,
+*                         which orders non-negative doubles.
+*   Integer keys that are close together share high bits, so
+*   entries are redistributed less often than with double keys.
+**/
+
+#define RHEAP_INT_KEYS 0
+#define RHEAP_DOUBLE_KEYS 1
+
+// "Opaque type" -- definition of rheap_struct hidden in rheap.c
+typedef struct rheap_struct RHEAP;
+
+/**
+* Function: rheap_create
+* Parameters: capacity - number of ids
+*             key_type - RHEAP_INT_KEYS or RHEAP_DOUBLE_KEYS
+* Returns:  Pointer to empty radix heap.
+*/
+extern RHEAP * rheap_create(int capacity, int key_type);
+
+/**
+* Function: rheap_free
+* Desc: deallocates all memory associated with rh.
+*/
+extern void rheap_free(RHEAP * rh);
+
+/**
+* Function: rheap_reset
+* Desc: removes all entries and forgets the last minimum, leaving
+*       rh as if just created, without allocating.
+* Runtime:  O(size)
+*/
+extern void rheap_reset(RHEAP * rh);
+
+/**
+* Function: rheap_insert
+* Returns: 1 on success; 0 on failure.
+*          fails if id is out of range, already present, or
+*            priority is invalid for the key type or below the
+*            last minimum returned.
+* Runtime:  O(1)
+*/
+extern int rheap_insert(RHEAP * rh, int id, double priority);
+
+/**
+* Function: rheap_decrease_key
+* Returns: 1 on success; 0 on failure.
+*          fails if id is not present, or new_priority is larger
+*            than the current one, invalid for the key type or
+*            below the last minimum returned.
+* Runtime:  O(1)
+*/
+extern int rheap_decrease_key(RHEAP * rh, int id, double new_priority);
+
+/**
+* Function: rheap_delete_min
+* Parameters: int pointer id and double pointer priority ("out")
+* Returns: 1 on success; 0 on failure (empty queue)
+* Desc: removes an entry with minimum priority and stores its
+*       id and priority in *id and *priority.
+* Runtime:  O(log C) amortized, C the largest key
+*/
+extern int rheap_delete_min(RHEAP * rh, int *id, double *priority);
+
+/**
+* Function: rheap_size, rheap_contains
+* same semantics as pq_size and pq_contains.
+* Runtime:  O(1)
+*/
+extern int rheap_size(RHEAP * rh);
+extern int rheap_contains(RHEAP * rh, int id);
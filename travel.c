@@ -2,22 +2,22 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <time.h>
 #include "pq.h"
 #include "hmap.h"
+#include "trie.h"
+#include "rheap.h"
+#include "bq.h"
+#include "lq.h"
 
-/**** STRUCT ****/
-/* struct for node */
-typedef struct lst_node {
-    int node_id;			//holds id of node
-    struct lst_node *next;	//pointer to next node in vertex linked list
-	char *nodeName;			//holds the name of the node
-	double edge;			//holds the distanct between 2 nodes
-} LST_NODE;
+#define MAX_SUGGESTIONS 10	//most vertex names offered for a mistyped location
+#define DEFAULT_QUEUE 1		//index in queues[] of the queue dijkstra uses unless one is named
+#define COMPARE_SOURCES 100		//dijkstra runs timed per queue in compare mode
+#define BUCKET_MAX_EDGE 1000	//largest edge length for which dijkstra uses a bucket queue
 
+/**** STRUCT ****/
 /* struct for vertex */
 typedef struct {
-    int out_degree;			//number of possible destinations from current vertex (number of nodes in linked list)
-    LST_NODE *neighbors; 	//array of nodes (head of linked list)
 	char *vertexName;		//holds the name of the vertex
 	int vertex_id;			//holds the id of the vertex
 } VERTEX;
@@ -27,18 +27,107 @@ typedef struct graph {
     int size;				//max size of graph (number of vertices)
     VERTEX *vertices;   	//srray of vertices
 	int currSize;			//current size of the graph
+	HMAP_PTR names;			//vertex name -> &vertices[id].vertex_id
+	int maxIntEdge;			//longest edge if every length is a whole number in [0, BUCKET_MAX_EDGE], else -1
+	/* compressed sparse rows: the edges leaving u are offsets[u] .. offsets[u+1]-1 of targets and weights */
+	int *offsets;			//first edge of each vertex (currSize+1 entries); NULL until graph_build_csr
+	int *targets;			//id of the vertex each edge leads to
+	double *weights;		//length of each edge
+	int numEdges;			//number of edges added
+	/* edge list filled by graph_add_edge and packed into rows by graph_build_csr */
+	int edgeCap;			//room in the edge list
+	int *edgeFrom;			//vertex each edge leaves
+	int *edgeTo;			//vertex each edge leads to
+	double *edgeLen;		//length of each edge
 } GRAPH_PTR;
 
+/* struct for a priority queue dijkstra can run on (a min-queue of vertex ids) */
+typedef int (*Q_UPDATE)(void *q, int id, double priority);
+typedef int (*Q_DELETE)(void *q, int *id, double *priority);
+typedef int (*Q_BULK)(void *q, int *ids, double *priorities, int n);
+typedef struct {
+	char *name;							//name selecting the queue on the command line
+	int needsIntEdges;					//only usable when graph->maxIntEdge >= 0
+	int lazy;							//decrease_key pushes a duplicate; stale entries are skipped on pop
+	void *(*create)(GRAPH_PTR* g);		//create an empty queue for the vertices of g
+	Q_UPDATE insert;					//add an id
+	Q_BULK insert_bulk;					//add ids (NULL means 0..n-1) in one pass; NULL if unsupported
+	Q_UPDATE decrease_key;				//lower the priority of an id
+	Q_DELETE delete_min;				//remove the id with the smallest priority
+	int (*size)(void *q);				//number of ids in the queue
+	int (*contains)(void *q, int id);	//is the id in the queue; NULL for lazy queues
+	void (*reset)(void *q);				//empty the queue for the next search
+	void (*free)(void *q);				//deallocate the queue
+	void *instance;						//kept between dijkstra calls; NULL until first used
+} QUEUE;
+
 /**** FUNCTION PROTOTYPES ****/
 GRAPH_PTR* graph_build(int n);
-void graph_add_edge(GRAPH_PTR* g, int u, int v, double edge, char* name);
+void graph_add_edge(GRAPH_PTR* g, int u, int v, double edge);
+void graph_build_csr(GRAPH_PTR* g);
 void graph_print(GRAPH_PTR* g);
 void graph_free(GRAPH_PTR* g);
 void graph_insert_vert_name(GRAPH_PTR* g, char *name, int *position);
 void graph_print_vertices(GRAPH_PTR* g);
 void printDistances(double arr[], int source);
-double * dijkstra(GRAPH_PTR* g, int start, int destination, int flag);
-int *alloc_arr(int n);
+double * dijkstra(GRAPH_PTR* g, int start, int destination, int flag, QUEUE *queue);
+void compare_queues(GRAPH_PTR* g);
+QUEUE *find_queue(char *name);
+void free_queues(void);
+void *heap2_create(GRAPH_PTR* g);
+void *heap4_create(GRAPH_PTR* g);
+void *heap8_create(GRAPH_PTR* g);
+void *radix_create(GRAPH_PTR* g);
+void *bucket_create(GRAPH_PTR* g);
+void *lazy_create(GRAPH_PTR* g);
+int heap_insert(void *q, int id, double priority);
+int heap_insert_bulk(void *q, int *ids, double *priorities, int n);
+int heap_decrease_key(void *q, int id, double priority);
+int heap_delete_min(void *q, int *id, double *priority);
+int heap_size(void *q);
+int heap_contains(void *q, int id);
+void heap_reset(void *q);
+void heap_free(void *q);
+int radix_insert(void *q, int id, double priority);
+int radix_decrease_key(void *q, int id, double priority);
+int radix_delete_min(void *q, int *id, double *priority);
+int radix_size(void *q);
+int radix_contains(void *q, int id);
+void radix_reset(void *q);
+void radix_free(void *q);
+int bucket_insert(void *q, int id, double priority);
+int bucket_decrease_key(void *q, int id, double priority);
+int bucket_delete_min(void *q, int *id, double *priority);
+int bucket_size(void *q);
+int bucket_contains(void *q, int id);
+void bucket_reset(void *q);
+void bucket_free(void *q);
+int lazy_push(void *q, int id, double priority);
+int lazy_pop(void *q, int *id, double *priority);
+int lazy_size(void *q);
+void lazy_reset(void *q);
+void lazy_free(void *q);
+
+/**** PRIORITY QUEUES ****/
+/* queues dijkstra can be run on; all pop non-decreasing distances so the radix heap and bucket queue apply */
+QUEUE queues[] = {
+	{"heap2", 0, 0, heap2_create, heap_insert, heap_insert_bulk, heap_decrease_key, heap_delete_min,
+		heap_size, heap_contains, heap_reset, heap_free, NULL},
+	{"heap4", 0, 0, heap4_create, heap_insert, heap_insert_bulk, heap_decrease_key, heap_delete_min,
+		heap_size, heap_contains, heap_reset, heap_free, NULL},
+	{"heap8", 0, 0, heap8_create, heap_insert, heap_insert_bulk, heap_decrease_key, heap_delete_min,
+		heap_size, heap_contains, heap_reset, heap_free, NULL},
+	{"radix", 0, 0, radix_create, radix_insert, NULL, radix_decrease_key, radix_delete_min,
+		radix_size, radix_contains, radix_reset, radix_free, NULL},
+	{"bucket", 1, 0, bucket_create, bucket_insert, NULL, bucket_decrease_key, bucket_delete_min,
+		bucket_size, bucket_contains, bucket_reset, bucket_free, NULL},
+	{"lazy", 0, 1, lazy_create, lazy_push, NULL, lazy_push, lazy_pop,
+		lazy_size, NULL, lazy_reset, lazy_free, NULL}
+};
+#define NUM_QUEUES (int)(sizeof(queues) / sizeof(queues[0]))
+TRIE_PTR graph_build_trie(GRAPH_PTR* g);
+int *lookup_location(TRIE_PTR trie, GRAPH_PTR* g, char *name);
+void print_suggestions(TRIE_PTR trie, GRAPH_PTR* g, char *name);
 
 /**** MAIN FUNCTION ****/
 int main(int argc, char **argv){
@@ -58,9 +147,9 @@ int main(int argc, char **argv){
 	double minDistance;		//to hold the minimum distance to destination
 	int sourcePosition;		//to hold start position
 	int destinationPosition;//to hold destination postiion
+	QUEUE *queue = &queues[DEFAULT_QUEUE];	//priority queue used by dijkstra
+	int queueNamed = 0;		//set if the user picked the queue
 	
-	int **a = malloc(sizeof(int*) * 10000);		//allocate space for alloc_arr function
-	int **b = malloc(sizeof(int*) * 10000);		//allocate space for alloc_arr function
 	start = malloc(sizeof(char) * 11);			//allocate space for user input start string
 	destination = malloc(sizeof(char) * 11);	//allocate space for user input destination string
 	distanceString = malloc(sizeof(char) * 11);	//allocate space for user input distance string
@@ -72,22 +161,31 @@ int main(int argc, char **argv){
 	//check to see if there is a file 
 	if(argv[1] == NULL){
 		printf("\n\tERROR: Can't open file\n");
-		free(a);				//free alloc_arr variable
-		free(b);				//free alloc_arr variable
 		free(start);			//free the start position
 		free(destination);		//free the destination position
 		free(distanceString);	//free the string that holds the distance
 		return 1;
 	}
 	
+	//an optional second argument names the queue dijkstra runs on (or asks for compare mode)
+	if(argc > 2 && strcmp(argv[2], "compare") != 0){
+		queue = find_queue(argv[2]);
+		queueNamed = 1;
+		if(queue == NULL){
+			printf("\n\tERROR: Unknown queue %s (use heap2, heap4, heap8, radix, bucket, lazy or compare)\n", argv[2]);
+			free(start);			//free the start position
+			free(destination);		//free the destination position
+			free(distanceString);	//free the string that holds the distance
+			return 1;
+		}
+	}
+	
 	FILE *f = fopen(argv[1], "r"); 					// "r" for read
 	char *buff = malloc(sizeof(char) * line_size);	//a buffer to hold what is read in
 	
 	//read in first line, print error if not able to
 	if(fscanf(f, "%d", &numVertices) == 0){
 		printf("\n\tERROR: Can't read in first integer\n");
-		free(a);				//free alloc_arr variable
-		free(b);				//free alloc_arr variable
 		free(buff);				//free the buffer
 		free(start);			//free the start position
 		free(destination);		//free the destination position
@@ -97,9 +195,6 @@ int main(int argc, char **argv){
 	
 	//initialize graph
 	GRAPH_PTR *graph = graph_build(numVertices);
-	//initialize hmap
-	HMAP_PTR map = hmap_create(0, 1.0);
-	int arr_alloc_counter = 0;	//used for alloc_arr func
 	//read in the rest of the file
 	while(getline(&buff, &line_size, f) != -1){
 		//skip the first line of file (read in previously)
@@ -136,32 +231,41 @@ int main(int argc, char **argv){
 		edgeLength = strtod(distanceString, NULL);
 		
 		/* store values */
-		//store vertex name into graph
+		//look up the vertex ids of both names, adding names not seen before
 		graph_insert_vert_name(graph, start, &sourcePosition);
-		//store vertex name into hmap
-		//set alloc_arr for hmap_set
-		a[arr_alloc_counter] = alloc_arr(1);
-		hmap_set(map, start, a[arr_alloc_counter]);
-		dijkstraVal = hmap_get(map, start);
-		dijkstraVal[0] = sourcePosition;
-		
-		/* store values */
-		//store vertex name into graph
 		graph_insert_vert_name(graph, destination, &destinationPosition);
-		//store vertex name into hmap
-		//set alloc_arr for hmap_set
-		b[arr_alloc_counter] = alloc_arr(1);
-		hmap_set(map, destination, b[arr_alloc_counter]);
-		dijkstraVal = hmap_get(map, destination);
-		dijkstraVal[0] = destinationPosition;
 		
 		//store neighbors
-		graph_add_edge(graph, sourcePosition, destinationPosition, edgeLength, destination);
-		graph_add_edge(graph, destinationPosition, sourcePosition, edgeLength, start);
-		arr_alloc_counter++;
+		graph_add_edge(graph, sourcePosition, destinationPosition, edgeLength);
+		graph_add_edge(graph, destinationPosition, sourcePosition, edgeLength);
 	}
 	//close the file that was opened
 	fclose(f);
+	//pack the edges into one array per field for fast traversal
+	graph_build_csr(graph);
+	//index the vertex names by prefix
+	TRIE_PTR trie = graph_build_trie(graph);
+	
+	//small whole-number edge lengths let dijkstra use a bucket queue
+	if(!queueNamed && graph->maxIntEdge >= 0)
+		queue = find_queue("bucket");
+	if(queue->needsIntEdges && graph->maxIntEdge < 0){
+		printf("\tNOTE: %s needs whole edge lengths up to %d; using %s\n", queue->name, BUCKET_MAX_EDGE, queues[DEFAULT_QUEUE].name);
+		queue = &queues[DEFAULT_QUEUE];
+	}
+	
+	//compare mode: time dijkstra with each queue instead of planning a trip
+	if(argc > 2 && strcmp(argv[2], "compare") == 0){
+		compare_queues(graph);
+		free(buff);				//free the buffer
+		free(start);			//free the start position
+		free(destination);		//free the destination position
+		free(distanceString);	//free the string that holds the distance
+		graph_free(graph);		//free the graph
+		trie_free(trie);		//free the name index
+		free_queues();			//free the queues kept by dijkstra
+		return 0;
+	}
 	
 	//print a list of all the vertices in the graph by name
 	graph_print_vertices(graph);
@@ -170,74 +274,60 @@ int main(int argc, char **argv){
 	printf("\nSELECT YOUR CURRENT LOCATION:\t");
 	scanf("%s", start);
 	
-	//hmap the start location
-	dijkstraVal = hmap_get(map, start);
+	//hmap the start location (completing a partially typed name)
+	dijkstraVal = lookup_location(trie, graph, start);
 	//check to see if vertex is in the hmap
 	if(dijkstraVal == NULL){
-		printf("\nVertex does not exist\n\n");
-		int i;
+		printf("\nVertex does not exist\n");
+		print_suggestions(trie, graph, start);
+		printf("\n");
 		/* free allocated memory */
-		for (i = 0; i < arr_alloc_counter; i++){
-			free(a[i]);
-			free(b[i]);
-		}
-		free(a);				//free alloc_arr variable
-		free(b);				//free alloc_arr variable
 		free(buff);				//free the buffer
 		free(start);			//free the start position
 		free(destination);		//free the destination position
 		free(distanceString);	//free the string that holds the distance
 		graph_free(graph);		//free the graph
-		hmap_free(map, 0);		//free hmap
+		trie_free(trie);		//free the name index
+		free_queues();			//free the queues kept by dijkstra
 		return 1;
 	}
 	
 	//run dijkstra's algorithm
-	distVals = dijkstra(graph, dijkstraVal[0], destinationPosition, 0);
+	distVals = dijkstra(graph, dijkstraVal[0], destinationPosition, 0, queue);
 		
 	//ask the user for their destination (also specified by vertex name).
 	printf("SELECT YOUR DESTINATION     :\t");
 	scanf("%s", destination);
 	
-	//hmap the destination location
-	dijkstraVal = hmap_get(map, destination);
+	//hmap the destination location (completing a partially typed name)
+	dijkstraVal = lookup_location(trie, graph, destination);
 	//check to see if vertex is in the hmap
 	if(dijkstraVal == NULL){
-		printf("\nVertex does not exist\n\n");
-		int i;
+		printf("\nVertex does not exist\n");
+		print_suggestions(trie, graph, destination);
+		printf("\n");
 		/* free allocated memory */
-		for (i = 0; i < arr_alloc_counter; i++){
-			free(a[i]);
-			free(b[i]);
-		}
-		free(a);				//free alloc_arr variable
-		free(b);				//free alloc_arr variable
 		free(buff);				//free the buffer
 		free(start);			//free the start position
 		free(destination);		//free the destination position
 		free(distanceString);	//free the string that holds the distance
 		graph_free(graph);		//free the graph
-		hmap_free(map, 0);		//free hmap
+		trie_free(trie);		//free the name index
+		free_queues();			//free the queues kept by dijkstra
 		return 1;
 	}
 	
 	//check to see if destination is unreachable
 	if(distVals[dijkstraVal[0]] == INT_MAX){
 		printf("\nCannot go from %s to %s\n\n", start, destination);
-		int i;
 		/* free allocated memory */
-		for (i = 0; i < arr_alloc_counter; i++){
-			free(a[i]);
-			free(b[i]);
-		}
-		free(a);				//free alloc_arr variable
-		free(b);				//free alloc_arr variable
 		free(buff);				//free the buffer
 		free(start);			//free the start position
 		free(destination);		//free the destination position
 		free(distanceString);	//free the string that holds the distance
 		graph_free(graph);		//free the graph
-		hmap_free(map, 0);		//free hmap
+		trie_free(trie);		//free the name index
+		free_queues();			//free the queues kept by dijkstra
 		return 1;
 		return;
 	}
@@ -247,10 +337,10 @@ int main(int argc, char **argv){
 		printf("\nYou can reach your destination in %.2lf units.\n\n", optimalDistance);
 	}	
 	
-	dijkstraVal = hmap_get(map, start);
+	dijkstraVal = hmap_get(graph->names, start);
 	//set current destination to start location
 	int currLoc = dijkstraVal[0];
-	dijkstraVal = hmap_get(map, destination);
+	dijkstraVal = hmap_get(graph->names, destination);
 	//set destination location to destination location
 	int destLoc = dijkstraVal[0];
 	double totalDistanceTraveled = 0.0;
@@ -258,7 +348,7 @@ int main(int argc, char **argv){
 	free(distVals);
 	
 	//print out shortest path
-	distVals = dijkstra(graph, currLoc, destLoc, 1);
+	distVals = dijkstra(graph, currLoc, destLoc, 1, queue);
 	free(distVals);
 	/** interactive loop **/
 	printf("\nTravel Time!\n\n");
@@ -276,17 +366,15 @@ int main(int argc, char **argv){
 		
 		//list user options for their next move: give up or select one of the vertices directly connected to the current location
 		printf("\n\tPOSSIBLE MOVES:\n\t\t0. I give up!\n");
-		//temp variable to traverse the neighbors linked list
-		LST_NODE *temp = graph->vertices[currLoc].neighbors;
+		int firstEdge = graph->offsets[currLoc];	//index of the first neighbor of the current location
 		//loop through the neighbors
-		while(temp != NULL){
-			printf("\t\t%d. %s\t(%.2lf)\n", j, temp->nodeName, temp->edge);
-			temp = temp->next;
+		for(i = firstEdge; i < graph->offsets[currLoc + 1]; i++){
+			printf("\t\t%d. %s\t(%.2lf)\n", j, graph->vertices[graph->targets[i]].vertexName, graph->weights[i]);
 			j++;
 		}
 		
 		//TODO give recommended move (i.e. vertex on a shortest path to destination)
-		printf("\tRECOMMENDED MOVE: %s\n", graph->vertices[currLoc].neighbors->nodeName);
+		printf("\tRECOMMENDED MOVE: %s\n", graph->vertices[graph->targets[firstEdge]].vertexName);
 		
 		userMove = -1;
 		//reads the user selection as an integer until it reads a valid user move
@@ -302,37 +390,25 @@ int main(int argc, char **argv){
 		//check if the user gave up
 		if(userMove == 0){
 			printf("\nThank you for traveling!\nGoodbye!\n\n");
-			for (i = 0; i < arr_alloc_counter; i++){
-				free(a[i]);
-				free(b[i]);
-			}
-			free(a);				//free alloc_arr variable
-			free(b);				//free alloc_arr variable
 			free(buff);				//free the buffer
 			free(start);			//free the start position
 			free(destination);		//free the destination position
 			free(distanceString);	//free the string that holds the distance
 			graph_free(graph);		//free the graph
-			hmap_free(map, 0);		//free hmap
+			trie_free(trie);		//free the name index
+			free_queues();			//free the queues kept by dijkstra
 			return 1;
 		}
 		//user wishes to travel to a neighbor
 		else{ 
-			int traverse = 1;							//variable to keep track of where you are in the neighbors linked list
-			temp = graph->vertices[currLoc].neighbors;	//temp variable to traverse the neighbors
-			//loop until you've reached the neighbor the user wishes to travel to
-			while(traverse != userMove){
-				temp = temp->next;
-				traverse++;
-			}
+			int move = firstEdge + userMove - 1;	//index of the edge the user wishes to travel along
 			//total distance traveled is updated
-			totalDistanceTraveled += temp->edge;
+			totalDistanceTraveled += graph->weights[move];
 			//user's current location is updated
-			currLoc = temp->node_id;
+			currLoc = graph->targets[move];
 			//min distance to destination is updated
-			dijkstraVal = hmap_get(map, temp->nodeName);
-			distVals = dijkstra(graph, dijkstraVal[0], destinationPosition, 0);
-			dijkstraVal = hmap_get(map, destination);
+			distVals = dijkstra(graph, currLoc, destinationPosition, 0, queue);
+			dijkstraVal = hmap_get(graph->names, destination);
 			minDistance = distVals[dijkstraVal[0]];
 			free(distVals);
 		}
@@ -345,18 +421,13 @@ int main(int argc, char **argv){
 	printf("Optimal Distance: %.2lf\nGoodbye\n\n", optimalDistance);
 	
 	/* free allocated memory */
-	for (i = 0; i < arr_alloc_counter; i++){
-		free(a[i]);
-		free(b[i]);
-	}
-	free(a);				//free alloc_arr variable
-	free(b);				//free alloc_arr variable
 	free(buff);				//free the buffer
 	free(start);			//free the start position
 	free(destination);		//free the destination position
 	free(distanceString);	//free the string that holds the distance
 	graph_free(graph);		//free the graph
-	hmap_free(map, 0);		//free hmap
+	trie_free(trie);		//free the name index
+	free_queues();			//free the queues kept by dijkstra
 	return 0;
 }//end main(...)
 
@@ -367,49 +438,100 @@ GRAPH_PTR* graph_build(int n){
     g->size = n;
     g->vertices = malloc(n * sizeof(VERTEX));
 	g->currSize = 0;	//initialize starting size as 0
+	g->maxIntEdge = 0;	//no edges yet
+	//index the names, sized for every vertex up front so loading never resizes
+	g->names = hmap_create_ex(0, 1.0, HMAP_FLAT | HMAP_ARENA | HMAP_BLOOM);
+	hmap_reserve(g->names, n);
+	g->offsets = NULL;	//rows are built once all edges are in
+	g->targets = NULL;
+	g->weights = NULL;
+	g->numEdges = 0;
+	g->edgeCap = 0;
+	g->edgeFrom = NULL;
+	g->edgeTo = NULL;
+	g->edgeLen = NULL;
     int i = 0;
     for(i = 0; i < n; i++) {
-        g->vertices[i].out_degree = 0;
-        g->vertices[i].neighbors = NULL;
 		g->vertices[i].vertexName = NULL;
 		g->vertices[i].vertex_id = -1;
     }
     return g;
 }//end graph_build(...)
 
-/* insert edge to vertex */
-void graph_add_edge(GRAPH_PTR* g, int u, int v, double edge, char* name){
-    LST_NODE *new = malloc(sizeof(LST_NODE));		//allocate a new node
-    new->node_id = v;						//set node's id to v
-	
-	new->edge = edge;
-	//new->nodeName = malloc(sizeof(char) * 15);
-	new->nodeName = g->vertices[v].vertexName;
+/* insert edge to vertex (takes effect at graph_build_csr) */
+void graph_add_edge(GRAPH_PTR* g, int u, int v, double edge){
+	//double the edge list when it is full
+	if(g->numEdges == g->edgeCap){
+		g->edgeCap = g->edgeCap == 0 ? 16 : 2 * g->edgeCap;
+		g->edgeFrom = realloc(g->edgeFrom, sizeof(int) * g->edgeCap);
+		g->edgeTo = realloc(g->edgeTo, sizeof(int) * g->edgeCap);
+		g->edgeLen = realloc(g->edgeLen, sizeof(double) * g->edgeCap);
+	}
+	g->edgeFrom[g->numEdges] = u;	//edge leaves u
+	g->edgeTo[g->numEdges] = v;		//edge leads to v
+	g->edgeLen[g->numEdges] = edge;	//length of the edge
+	g->numEdges++;
 	
-    new->next = g->vertices[u].neighbors;	//set the next pointer to point to the graph's front node
-    g->vertices[u].neighbors = new; 		//set to new node to be the graph's front node
-    g->vertices[u].out_degree++;			//increment number of possible destinations from that vertex of the graph
+	//track whether the edge lengths still qualify for a bucket queue
+	if(g->maxIntEdge >= 0){
+		if(edge < 0 || edge > BUCKET_MAX_EDGE || edge != (int)edge)
+			g->maxIntEdge = -1;
+		else if(edge > g->maxIntEdge)
+			g->maxIntEdge = (int)edge;
+	}
 }//end graph_add_edge(...)
 
+/* pack the edge list into compressed sparse rows with a counting sort by source vertex */
+void graph_build_csr(GRAPH_PTR* g){
+	int i, u;
+	int n = g->currSize;	//number of vertices
+	
+	//count the edges leaving each vertex, then turn the counts into row starts
+	g->offsets = calloc(n + 1, sizeof(int));
+	for(i = 0; i < g->numEdges; i++)
+		g->offsets[g->edgeFrom[i] + 1]++;
+	for(u = 0; u < n; u++)
+		g->offsets[u + 1] += g->offsets[u];
+	
+	//place each edge in its row; newest edges come first, the order moves have always been listed in
+	int *next = malloc(sizeof(int) * (n + 1));	//next free slot of each row
+	memcpy(next, g->offsets, sizeof(int) * (n + 1));
+	g->targets = malloc(sizeof(int) * (g->numEdges + 1));
+	g->weights = malloc(sizeof(double) * (g->numEdges + 1));
+	for(i = g->numEdges - 1; i >= 0; i--){
+		u = g->edgeFrom[i];
+		g->targets[next[u]] = g->edgeTo[i];
+		g->weights[next[u]] = g->edgeLen[i];
+		next[u]++;
+	}
+	free(next);
+	
+	//the edge list is no longer needed
+	free(g->edgeFrom);
+	free(g->edgeTo);
+	free(g->edgeLen);
+	g->edgeFrom = NULL;
+	g->edgeTo = NULL;
+	g->edgeLen = NULL;
+	g->edgeCap = 0;
+}//end graph_build_csr(...)
+
 /* print the graph */
 void graph_print(GRAPH_PTR* g){
-    int i;
+    int i, j;
     for(i = 0; i < g->size; i++) {
         printf("[%d", i);
-		//print linked list
-        LST_NODE *cur = g->vertices[i].neighbors;
 		if(g->vertices[i].vertexName != NULL)
 			printf("-%s]: ", g->vertices[i].vertexName);
 		else
 			printf("]: ");
 		
-		if(cur == NULL)
+		//print the row of edges (vertices past currSize have none)
+		if(g->offsets == NULL || i >= g->currSize || g->offsets[i] == g->offsets[i + 1])
 			printf("EMPTY");
 		else
-			while(cur != NULL) {
-				printf("(%d-%s, %.2lf), ", cur->node_id, cur->nodeName, cur->edge);
-				cur = cur->next;
-			}
+			for(j = g->offsets[i]; j < g->offsets[i + 1]; j++)
+				printf("(%d-%s, %.2lf), ", g->targets[j], g->vertices[g->targets[j]].vertexName, g->weights[j]);
         printf("\n");
     }
 }//end graph_print(...)
@@ -417,55 +539,43 @@ void graph_print(GRAPH_PTR* g){
 /* deallocate space created by graph_build */
 void graph_free(GRAPH_PTR* g){
     int i = 0;
-    for(i = 0; i < g->size; i++){
-        LST_NODE *cur = g->vertices[i].neighbors;
-        while(cur != NULL) {
-            LST_NODE *temp = cur->next;
-            free(cur);
-            cur = temp;
-        }
+    for(i = 0; i < g->size; i++)
 		free(g->vertices[i].vertexName);
-    }	
+	hmap_free(g->names, 0);
+	free(g->offsets);
+	free(g->targets);
+	free(g->weights);
+	free(g->edgeFrom);
+	free(g->edgeTo);
+	free(g->edgeLen);
     free(g->vertices);
     free(g);
 }//end graph_print(...)
 
-/* insert vertex names */
+/* find the id of a vertex name, adding the vertex if the name is new */
 void graph_insert_vert_name(GRAPH_PTR* g, char *name, int *position){
-	int i;
-	//check if graph has no vertices
-	if(g->currSize == 0){
-		g->vertices[g->currSize].vertexName = malloc(sizeof(char) * 11);
-		strcpy(g->vertices[g->currSize].vertexName, name);
-		g->vertices[g->currSize].vertex_id = g->currSize;
-		
-		*position = g->currSize;
-		
-		//check to see if size will go over
-		if(g->currSize + 1 > g->size)
-			exit(1);
-		g->currSize++;
+	int inserted;	//set by hmap_upsert when the name is new
+	//one lookup finds or creates the name's entry
+	void **valSlot = hmap_upsert(g->names, name, &inserted);
+	
+	//if vertex already exists, its id is the value
+	if(!inserted){
+		*position = *(int *)*valSlot;
+		return;
 	}
-	//loop through all existing vertices
-	for(i = 0; i < g->currSize; i++)
-		//if vertex already exists, do nothing
-		if(strcmp(g->vertices[i].vertexName, name) == 0){
-			*position = i;
-			return;		
-		}
+	
+	//check to see if size will go over
+	if(g->currSize + 1 > g->size)
+		exit(1);
 	
 	//otherwise, add new vertex at currSize index
 	g->vertices[g->currSize].vertexName = malloc(sizeof(char) * 11);
 	strcpy(g->vertices[g->currSize].vertexName, name);
 	g->vertices[g->currSize].vertex_id = g->currSize;
+	*valSlot = &g->vertices[g->currSize].vertex_id;
 	
 	*position = g->currSize;
-	
-	//check to see if size will go over
-	if(g->currSize + 1 > g->size)
-			exit(1);
 	g->currSize++;
-	return;
 }
 
 /* print the vertices of the graph */
@@ -484,8 +594,55 @@ void graph_print_vertices(GRAPH_PTR* g){
 	printf("\n");
 }
 
+/* build a radix trie mapping each vertex name to its id */
+TRIE_PTR graph_build_trie(GRAPH_PTR* g){
+	TRIE_PTR trie = trie_create();
+	int i;
+	for(i = 0; i < g->currSize; i++)
+		trie_insert(trie, g->vertices[i].vertexName, i);
+	return trie;
+}
+
+/* look up a location typed by the user: a name that starts exactly one vertex name is completed to it (name is overwritten) */
+int *lookup_location(TRIE_PTR trie, GRAPH_PTR* g, char *name){
+	int ids[2];		//ids of the first two vertices whose names start with name
+	int *val;		//hmap value of the location
+	
+	//exact name
+	val = hmap_get(g->names, name);
+	if(val != NULL)
+		return val;
+	//unique completion of a partial name
+	if(trie_prefix(trie, name, ids, 2) == 1){
+		strcpy(name, g->vertices[ids[0]].vertexName);
+		printf("\t(%s)\n", name);
+		return hmap_get(g->names, name);
+	}
+	return NULL;
+}
+
+/* print the vertices whose names share the longest possible prefix with an unknown name */
+void print_suggestions(TRIE_PTR trie, GRAPH_PTR* g, char *name){
+	int ids[MAX_SUGGESTIONS];	//ids of vertices whose names share a prefix with name
+	int len;					//length of the longest prefix of name some vertex shares
+	int n, i;
+	
+	len = trie_match_len(trie, name);
+	if(len == 0)
+		return;
+	char *prefix = malloc(len + 1);
+	memcpy(prefix, name, len);
+	prefix[len] = '\0';
+	n = trie_prefix(trie, prefix, ids, MAX_SUGGESTIONS);
+	printf("Did you mean:");
+	for(i = 0; i < n; i++)
+		printf(" %s", g->vertices[ids[i]].vertexName);
+	printf("\n");
+	free(prefix);
+}
+
 /* dijkstra's algroithm to find the shortest path from start position to all vertices */
-double * dijkstra(GRAPH_PTR* g, int start, int destination, int flag){
+double * dijkstra(GRAPH_PTR* g, int start, int destination, int flag, QUEUE *queue){
 	int i, j;						//for loops baby for loops
 	int numVertices = g->currSize;	//hold the current number of vertices
 	double *distVals;				//hold distance values
@@ -496,15 +653,18 @@ double * dijkstra(GRAPH_PTR* g, int start, int destination, int flag){
 	
 	//allocate space for distance array
 	distVals = malloc(sizeof(double) * numVertices);
-	//create min heap
-	PQ *minHeap = pq_create(numVertices, 1);
+	//reuse the min-queue selected by the caller, creating it on first use
+	if(queue->instance == NULL)
+		queue->instance = queue->create(g);
+	else
+		queue->reset(queue->instance);
+	void *minHeap = queue->instance;
 
-	//initialize min-heap with all vertices and distance values of all vertices
+	//initialize distance values of all vertices
 	for(i = 0; i < numVertices; ++i){
 		//initialize to max of int
 		distVals[i] = INT_MAX;
 		visited[i] = 0;
-		pq_insert(minHeap, i, distVals[i]);
 	}
 	
 	//make distance values of start vertex as 0 so it is extracted first
@@ -513,36 +673,41 @@ double * dijkstra(GRAPH_PTR* g, int start, int destination, int flag){
 	visited[start] = 1;
 	//set previous node
 	pred[start] = start;
-	//change priority
-	pq_change_priority(minHeap, start, distVals[start]);
+	
+	//initialize min-heap with all vertices (in one pass if the queue supports it); a lazy queue starts with just the start vertex
+	if(queue->lazy)
+		queue->insert(minHeap, start, 0.0);
+	else if(queue->insert_bulk != NULL)
+		queue->insert_bulk(minHeap, NULL, distVals, numVertices);
+	else
+		for(i = 0; i < numVertices; ++i)
+			queue->insert(minHeap, i, distVals[i]);
 	
 	//loop to finalize shortest distance
 	
-	while(pq_size(minHeap) > 0){
+	while(queue->size(minHeap) > 0){
 		//extract vertex number and value at the top of the heap
-		pq_delete_top(minHeap, &vertexNumber, &topValue);
+		queue->delete_min(minHeap, &vertexNumber, &topValue);
+		//skip stale entries left behind by a lazy queue's decrease_key
+		if(queue->lazy && topValue > distVals[vertexNumber])
+			continue;
 		//mark that vertex visited
 		visited[vertexNumber] = 1;
-		//temp node for traversal
-		LST_NODE *temp = g->vertices[vertexNumber].neighbors;
-		
-		//loop through all adjacent vertices
-		while(temp != NULL){
-			i = temp->node_id;
+		//loop through all adjacent vertices (one row of the graph)
+		for(j = g->offsets[vertexNumber]; j < g->offsets[vertexNumber + 1]; j++){
+			i = g->targets[j];
 			
 			//check if vertex is visited and shortest distance to i is not finalized yet, and distance to i through vertexNumber is less than it's previously calculated distance
-			if(pq_contains(minHeap, i) && distVals[vertexNumber] != INT_MAX && (temp->edge + distVals[vertexNumber]) < distVals[i]){
+			if((queue->lazy || queue->contains(minHeap, i)) && distVals[vertexNumber] != INT_MAX && (g->weights[j] + distVals[vertexNumber]) < distVals[i]){
 				//check visited status
 				if(!visited[i])
 					//set new previous node
 					pred[i] = vertexNumber;
 				//update the distance value at that vertex
-				distVals[i] = distVals[vertexNumber] + temp->edge;
-				//change priorities
-				pq_change_priority(minHeap, i, distVals[i]);
+				distVals[i] = distVals[vertexNumber] + g->weights[j];
+				//move i up the heap to its new (smaller) distance (or push it again)
+				queue->decrease_key(minHeap, i, distVals[i]);
 			}
-			//move to next node
-			temp = temp->next;
 		}
 	}
 	if(flag == 1){
@@ -581,10 +746,192 @@ double * dijkstra(GRAPH_PTR* g, int start, int destination, int flag){
 		free(path);
 	}
 	
-	pq_free(minHeap);
 	return distVals;
 }
 
+/* time dijkstra from the first COMPARE_SOURCES vertices with every queue */
+void compare_queues(GRAPH_PTR* g){
+	int numSources = g->currSize < COMPARE_SOURCES ? g->currSize : COMPARE_SOURCES;
+	double checksum;				//sum of reachable distances, same for every queue
+	double *distVals;				//distances from one source
+	clock_t begin;					//start time of one queue's runs
+	int i, j, k;
+	
+	printf("Comparing priority queues (%d dijkstra runs each):\n", numSources);
+	for(k = 0; k < NUM_QUEUES; k++){
+		//skip queues this graph's edge lengths rule out
+		if(queues[k].needsIntEdges && g->maxIntEdge < 0)
+			continue;
+		checksum = 0.0;
+		begin = clock();
+		for(i = 0; i < numSources; i++){
+			distVals = dijkstra(g, i, i, 0, &queues[k]);
+			for(j = 0; j < g->currSize; j++)
+				if(distVals[j] != INT_MAX)
+					checksum += distVals[j];
+			free(distVals);
+		}
+		printf("\t%s: %.3lf ms per run (checksum %.2lf)\n", queues[k].name,
+			1000.0 * (clock() - begin) / CLOCKS_PER_SEC / numSources, checksum);
+	}
+}
+
+/* find the queue with the given name; NULL if there is none */
+QUEUE *find_queue(char *name){
+	int k;
+	for(k = 0; k < NUM_QUEUES; k++)
+		if(strcmp(queues[k].name, name) == 0)
+			return &queues[k];
+	return NULL;
+}
+
+/* free the queue instances dijkstra kept */
+void free_queues(void){
+	int k;
+	for(k = 0; k < NUM_QUEUES; k++)
+		if(queues[k].instance != NULL){
+			queues[k].free(queues[k].instance);
+			queues[k].instance = NULL;
+		}
+}
+
+/* create the queues in queues[] */
+void *heap2_create(GRAPH_PTR* g){
+	return pq_create_dary(g->currSize, 1, 2);
+}
+
+void *heap4_create(GRAPH_PTR* g){
+	return pq_create_dary(g->currSize, 1, 4);
+}
+
+void *heap8_create(GRAPH_PTR* g){
+	return pq_create_dary(g->currSize, 1, 8);
+}
+
+void *radix_create(GRAPH_PTR* g){
+	return rheap_create(g->currSize, RHEAP_DOUBLE_KEYS);
+}
+
+void *bucket_create(GRAPH_PTR* g){
+	//no tentative distance exceeds the current minimum by more than the longest edge
+	return bq_create(g->currSize, g->maxIntEdge);
+}
+
+/* create an insert-only queue for lazy-deletion dijkstra */
+void *lazy_create(GRAPH_PTR* g){
+	//starts at one entry per vertex and grows if decrease_key pushes more
+	return lq_create(g->currSize);
+}
+
+/* the queue operations in queues[], each passing the void * instance on to its library */
+int heap_insert(void *q, int id, double priority){
+	return pq_insert(q, id, priority);
+}
+
+int heap_insert_bulk(void *q, int *ids, double *priorities, int n){
+	return pq_insert_bulk(q, ids, priorities, n);
+}
+
+int heap_decrease_key(void *q, int id, double priority){
+	return pq_decrease_key(q, id, priority);
+}
+
+int heap_delete_min(void *q, int *id, double *priority){
+	return pq_delete_top(q, id, priority);
+}
+
+int heap_size(void *q){
+	return pq_size(q);
+}
+
+int heap_contains(void *q, int id){
+	return pq_contains(q, id);
+}
+
+void heap_reset(void *q){
+	pq_reset(q);
+}
+
+void heap_free(void *q){
+	pq_free(q);
+}
+
+int radix_insert(void *q, int id, double priority){
+	return rheap_insert(q, id, priority);
+}
+
+int radix_decrease_key(void *q, int id, double priority){
+	return rheap_decrease_key(q, id, priority);
+}
+
+int radix_delete_min(void *q, int *id, double *priority){
+	return rheap_delete_min(q, id, priority);
+}
+
+int radix_size(void *q){
+	return rheap_size(q);
+}
+
+int radix_contains(void *q, int id){
+	return rheap_contains(q, id);
+}
+
+void radix_reset(void *q){
+	rheap_reset(q);
+}
+
+void radix_free(void *q){
+	rheap_free(q);
+}
+
+int bucket_insert(void *q, int id, double priority){
+	return bq_insert(q, id, priority);
+}
+
+int bucket_decrease_key(void *q, int id, double priority){
+	return bq_decrease_key(q, id, priority);
+}
+
+int bucket_delete_min(void *q, int *id, double *priority){
+	return bq_delete_min(q, id, priority);
+}
+
+int bucket_size(void *q){
+	return bq_size(q);
+}
+
+int bucket_contains(void *q, int id){
+	return bq_contains(q, id);
+}
+
+void bucket_reset(void *q){
+	bq_reset(q);
+}
+
+void bucket_free(void *q){
+	bq_free(q);
+}
+
+int lazy_push(void *q, int id, double priority){
+	return lq_push(q, id, priority);
+}
+
+int lazy_pop(void *q, int *id, double *priority){
+	return lq_pop(q, id, priority);
+}
+
+int lazy_size(void *q){
+	return lq_size(q);
+}
+
+void lazy_reset(void *q){
+	lq_reset(q);
+}
+
+void lazy_free(void *q){
+	lq_free(q);
+}
+
 /* prints distances from source */
 void printDistances(double arr[], int source){
 	int i;
@@ -593,14 +940,4 @@ void printDistances(double arr[], int source){
 		printf("%d\t\t%.2lf\n", i, arr[i]);
 }
 
-/* used for hmap */
-int *alloc_arr(int n){
-	int i;
-	int *a;
-	a = malloc(n * sizeof(int));
-	for(i=0; i<n; i++)
-		a[i] = 0;
-	
-	return a;
-}
 
@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trie.h"
+
+#define INIT_KIDS 2
+#define INIT_BUFS 64
+
+
+/******** STRUCTS AND TYPEDEFS *********/
+
+/* label points into one of the trie's key buffers; splitting a
+*    node only moves pointers, never copies characters.
+*/
+typedef struct trie_node {
+    char *label;
+    unsigned len;               // label length
+    int id;                     // -1 if no key ends here
+    int nkids;
+    int cap;
+    unsigned char *first;       // first label byte of each kid, sorted
+    struct trie_node **kids;
+} TRIE_NODE;
+
+struct trie {
+    TRIE_NODE *root;            // empty label
+    int n;
+    char **bufs;                // key suffixes copied by trie_insert
+    int nbufs;
+    int bufs_cap;
+    TRIE_NODE **stack;          // scratch for trie_prefix
+    int stack_cap;
+};
+
+/******** END STRUCTS AND TYPEDEFS *********/
+
+/***** FORWARD DECLARATIONS *****/
+static TRIE_NODE *new_node(char *label, unsigned len, int id);
+static int kid_index(TRIE_NODE *p, unsigned char c);
+static TRIE_NODE *find_kid(TRIE_NODE *p, unsigned char c);
+static void add_kid(TRIE_NODE *p, TRIE_NODE *kid);
+static char *save_key(TRIE_PTR t, char *s);
+static TRIE_NODE *locate(TRIE_PTR t, char *s, unsigned *matched);
+static void push(TRIE_PTR t, int *top, TRIE_NODE *p);
+/***** END FORWARD DECLARATIONS *****/
+
+
+/***** BEGIN trie FUNCTIONS ******/
+
+TRIE_PTR trie_create(void) {
+TRIE_PTR t = malloc(sizeof(struct trie));
+
+  t->root = new_node("", 0, -1);
+  t->n = 0;
+  t->bufs_cap = INIT_BUFS;
+  t->bufs = malloc(t->bufs_cap * sizeof(char *));
+  t->nbufs = 0;
+  t->stack_cap = 0;
+  t->stack = NULL;
+  return t;
+}
+
+int trie_size(TRIE_PTR t) {
+  return t->n;
+}
+
+int trie_insert(TRIE_PTR t, char *key, int id) {
+TRIE_NODE *p = t->root, *c, *mid;
+unsigned m;
+
+  if(id < 0)
+	return 0;
+  while(*key != '\0') {
+	c = find_kid(p, (unsigned char)*key);
+	if(c == NULL) {  // new leaf holds the rest of the key
+	   add_kid(p, new_node(save_key(t, key), strlen(key), id));
+	   t->n++;
+	   return 1;
+	}
+	for(m=1; m < c->len && key[m] == c->label[m]; m++)
+	   ;
+	if(m < c->len) {  // key leaves c's label part way:  split c
+	   mid = new_node(c->label, m, -1);
+	   c->label += m;
+	   c->len -= m;
+	   p->kids[kid_index(p, (unsigned char)*key)] = mid;
+	   add_kid(mid, c);
+	   c = mid;
+	}
+	p = c;
+	key += m;
+  }
+  if(p->id >= 0 || p == t->root)
+	return 0;
+  p->id = id;
+  t->n++;
+  return 1;
+}
+
+int trie_get(TRIE_PTR t, char *key) {
+unsigned matched;
+TRIE_NODE *p = locate(t, key, &matched);
+
+  // key must end exactly at the end of p's label
+  if(p == NULL || matched != p->len)
+	return -1;
+  return p->id;
+}
+
+int trie_prefix(TRIE_PTR t, char *prefix, int *ids, int max_ids) {
+unsigned matched;
+TRIE_NODE *p = locate(t, prefix, &matched);
+int top = 0, cnt = 0, i;
+
+  if(p == NULL)
+	return 0;
+  // depth-first, kids pushed in reverse so the smallest pops first
+  push(t, &top, p);
+  while(top > 0 && cnt < max_ids) {
+	p = t->stack[--top];
+	if(p->id >= 0)
+	   ids[cnt++] = p->id;
+	for(i=p->nkids-1; i>=0; i--)
+	   push(t, &top, p->kids[i]);
+  }
+  return cnt;
+}
+
+int trie_match_len(TRIE_PTR t, char *s) {
+TRIE_NODE *p = t->root, *c;
+int len = 0;
+unsigned m;
+
+  while(s[len] != '\0') {
+	c = find_kid(p, (unsigned char)s[len]);
+	if(c == NULL)
+	   break;
+	for(m=1; m < c->len && s[len+m] == c->label[m]; m++)
+	   ;
+	len += m;
+	if(m < c->len)
+	   break;
+	p = c;
+  }
+  return len;
+}
+
+void trie_free(TRIE_PTR t) {
+TRIE_NODE *p;
+int top = 0, i;
+
+  push(t, &top, t->root);
+  while(top > 0) {
+	p = t->stack[--top];
+	for(i=0; i<p->nkids; i++)
+	   push(t, &top, p->kids[i]);
+	free(p->first);
+	free(p->kids);
+	free(p);
+  }
+  for(i=0; i<t->nbufs; i++)
+	free(t->bufs[i]);
+  free(t->bufs);
+  free(t->stack);
+  free(t);
+}
+
+/***** END trie FUNCTIONS ******/
+
+
+/**** UTILITY FUNCTIONS *******/
+
+static TRIE_NODE *new_node(char *label, unsigned len, int id) {
+TRIE_NODE *p = malloc(sizeof(TRIE_NODE));
+
+  p->label = label;
+  p->len = len;
+  p->id = id;
+  p->nkids = 0;
+  p->cap = 0;
+  p->first = NULL;
+  p->kids = NULL;
+  return p;
+}
+
+// binary search; index of the kid starting with c, or of the
+//   position where such a kid would go
+static int kid_index(TRIE_NODE *p, unsigned char c) {
+int lo = 0, hi = p->nkids, mid;
+
+  while(lo < hi) {
+	mid = (lo + hi) / 2;
+	if(p->first[mid] < c)
+	   lo = mid + 1;
+	else
+	   hi = mid;
+  }
+  return lo;
+}
+
+static TRIE_NODE *find_kid(TRIE_NODE *p, unsigned char c) {
+int i = kid_index(p, c);
+
+  if(i < p->nkids && p->first[i] == c)
+	return p->kids[i];
+  return NULL;
+}
+
+// caller guarantees no kid starts with the same byte
+static void add_kid(TRIE_NODE *p, TRIE_NODE *kid) {
+unsigned char c = (unsigned char)kid->label[0];
+int i = kid_index(p, c);
+
+  if(p->nkids == p->cap) {
+	p->cap = p->cap ? 2*p->cap : INIT_KIDS;
+	p->first = realloc(p->first, p->cap);
+	p->kids = realloc(p->kids, p->cap * sizeof(TRIE_NODE *));
+  }
+  memmove(p->first + i + 1, p->first + i, p->nkids - i);
+  memmove(p->kids + i + 1, p->kids + i, (p->nkids - i) * sizeof(TRIE_NODE *));
+  p->first[i] = c;
+  p->kids[i] = kid;
+  p->nkids++;
+}
+
+static char *save_key(TRIE_PTR t, char *s) {
+size_t len = strlen(s) + 1;
+char *c = malloc(len);
+
+  memcpy(c, s, len);
+  if(t->nbufs == t->bufs_cap) {
+	t->bufs_cap *= 2;
+	t->bufs = realloc(t->bufs, t->bufs_cap * sizeof(char *));
+  }
+  t->bufs[t->nbufs++] = c;
+  return c;
+}
+
+/*
+* follows s down from the root.  \returns the node whose
+*   subtree holds exactly the keys starting with s (NULL if
+*   there are none); *matched is how much of that node's label
+*   s covers.
+*/
+static TRIE_NODE *locate(TRIE_PTR t, char *s, unsigned *matched) {
+TRIE_NODE *p = t->root, *c;
+unsigned m;
+
+  *matched = 0;
+  while(*s != '\0') {
+	c = find_kid(p, (unsigned char)*s);
+	if(c == NULL)
+	   return NULL;
+	for(m=1; m < c->len && s[m] == c->label[m]; m++)
+	   ;
+	if(m < c->len && s[m] != '\0')
+	   return NULL;  // s leaves the label part way
+	p = c;
+	*matched = m;
+	s += m;
+  }
+  if(p == t->root)
+	*matched = 0;
+  return p;
+}
+
+static void push(TRIE_PTR t, int *top, TRIE_NODE *p) {
+  if(*top == t->stack_cap) {
+	t->stack_cap = t->stack_cap ? 2*t->stack_cap : 64;
+	t->stack = realloc(t->stack, t->stack_cap * sizeof(TRIE_NODE *));
+  }
+  t->stack[(*top)++] = p;
+}
+/**** END UTILITY FUNCTIONS *******/
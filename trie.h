@@ -0,0 +1,69 @@
+
+/**
+* General description:  compressed radix trie (Patricia trie)
+*   mapping string keys to integer ids, for prefix queries
+*   such as autocomplete over vertex names.
+*
+*   Each edge is labelled with a whole run of characters, so a
+*   trie over n keys has at most 2n nodes no matter how long
+*   the keys are.  Children are kept sorted by the first byte
+*   of their label.  Keys are copied into the trie.
+*
+*   A prefix query costs time proportional to the length of
+*   the prefix plus the number of ids reported; ids come out
+*   in lexicographic order of their keys.
+*
+*   There is no removal; the trie is meant to be built once
+*   after loading.
+**/
+
+typedef struct trie *TRIE_PTR;
+
+/**
+* \returns an empty trie.
+*/
+extern TRIE_PTR trie_create(void);
+
+/**
+* \returns number of keys in the trie
+*/
+extern int trie_size(TRIE_PTR t);
+
+/**
+* associates id (>= 0) with key.
+*
+* \returns 1 if key was added; 0 if key was already present
+*   (its id is left unchanged) or id is negative.
+*/
+extern int trie_insert(TRIE_PTR t, char *key, int id);
+
+/**
+* \returns the id associated with key, or -1 if key is not
+*   in the trie.
+*/
+extern int trie_get(TRIE_PTR t, char *key);
+
+/**
+* collects the ids of all keys starting with prefix (the
+*   empty prefix matches every key) in lexicographic order
+*   of the keys.
+*
+* At most max_ids ids are written to ids[].
+* \returns number of ids written.
+*
+* Runtime:  O(strlen(prefix) + number of ids written)
+*/
+extern int trie_prefix(TRIE_PTR t, char *prefix, int *ids, int max_ids);
+
+/**
+* \returns the length of the longest prefix of s that is
+*   also a prefix of some key in the trie (0 if none).
+*   Useful for suggesting keys close to a mistyped one.
+*/
+extern int trie_match_len(TRIE_PTR t, char *s);
+
+/**
+* Deallocates all memory associated with the trie.
+*/
+extern void trie_free(TRIE_PTR t);
+